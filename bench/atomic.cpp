@@ -0,0 +1,141 @@
+#include "LightAtomic.hpp"
+#include "State.hpp"
+#include "Thread.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Atomic against its lighter replacements: the bytes every table entry
+// takes, table traffic by 1 to N threads with nine reads for every write,
+// every thread reading one shared value, and two threads handing a value
+// back and forth with wait_until_cond.
+
+struct entry
+{
+    double score = 0;
+    int evaluated_depth = 0;
+};
+
+const size_t OPERATIONS = 1 << 20; // per thread
+const int HANDOFFS = 1 << 14;
+
+template< typename Body >
+double parallel_seconds (size_t num_of_threads, Body body)
+{
+    std::vector<std::thread> threads;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < num_of_threads; ++t)
+        threads.push_back(std::thread(body, t));
+    for (auto &thread : threads)
+        thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// keeps the loops from being optimized away
+static std::atomic<size_t> checksum(0);
+
+template< template< typename, typename > class Cell >
+double table_operations (size_t num_of_threads, const std::vector<int> &keys)
+{
+    std::unique_ptr<Cell<entry, std::not_equal_to<entry> >[]> table(new Cell<entry, std::not_equal_to<entry> >[keys.size()]);
+
+    const double seconds = parallel_seconds(num_of_threads, [&](size_t t) {
+        double sum = 0;
+        size_t i = t * 7919;
+        for (size_t n = 0; n < OPERATIONS; ++n, ++i)
+        {
+            auto &cell = table[keys[i % keys.size()]];
+            if (n % 10)
+                cell.access([&](const entry &e) { sum += e.score; });
+            else
+                cell.mutate([](entry &e) { ++e.evaluated_depth; });
+        }
+        checksum += sum;
+    });
+
+    return num_of_threads * OPERATIONS / seconds;
+}
+
+template< template< typename, typename > class Cell >
+double shared_reads (size_t num_of_threads)
+{
+    Cell<size_t, std::not_equal_to<size_t> > shared(1);
+
+    const double seconds = parallel_seconds(num_of_threads, [&](size_t) {
+        size_t sum = 0;
+        for (size_t n = 0; n < OPERATIONS; ++n)
+            sum += shared.get();
+        checksum += sum;
+    });
+
+    return num_of_threads * OPERATIONS / seconds;
+}
+
+// one thread writes the odd values, the other the even ones, each waiting for the other's turn
+template< template< typename, typename > class Cell >
+double handoffs_per_second()
+{
+    Cell<int, std::not_equal_to<int> > turn(0);
+
+    const double seconds = parallel_seconds(2, [&](size_t t) {
+        for (int k = 0; k < HANDOFFS; ++k)
+            if (t == 0)
+            {
+                turn.set(2 * k + 1);
+                turn.wait_until_cond(2 * k + 1);
+            }
+            else
+            {
+                turn.wait_until_cond(2 * k);
+                turn.set(2 * k + 2);
+            }
+    });
+
+    return 2 * HANDOFFS / seconds;
+}
+
+int main()
+{
+    const size_t max_threads = std::max(4u, 2 * std::thread::hardware_concurrency());
+
+    std::vector<int> keys;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+        keys.push_back(hash);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(12345));
+
+    std::cout << "bytes per entry:  Atomic " << sizeof(Thread::Atomic<entry>)
+              << "  LightAtomic " << sizeof(Thread::LightAtomic<entry>)
+              << "  SeqAtomic " << sizeof(Thread::SeqAtomic<entry>) << std::endl;
+
+    std::cout << "table ops/sec" << std::endl
+              << "threads  Atomic  LightAtomic  SeqAtomic" << std::endl;
+    for (size_t num_of_threads = 1; num_of_threads <= max_threads; num_of_threads *= 2)
+        std::cout << num_of_threads << "  " << table_operations<Thread::Atomic>(num_of_threads, keys)
+                  << "  " << table_operations<Thread::LightAtomic>(num_of_threads, keys)
+                  << "  " << table_operations<Thread::SeqAtomic>(num_of_threads, keys) << std::endl;
+
+    std::cout << "shared gets/sec" << std::endl
+              << "threads  Atomic  LightAtomic  SeqAtomic" << std::endl;
+    for (size_t num_of_threads = 1; num_of_threads <= max_threads; num_of_threads *= 2)
+        std::cout << num_of_threads << "  " << shared_reads<Thread::Atomic>(num_of_threads)
+                  << "  " << shared_reads<Thread::LightAtomic>(num_of_threads)
+                  << "  " << shared_reads<Thread::SeqAtomic>(num_of_threads) << std::endl;
+
+    std::cout << "handoffs/sec:  Atomic " << handoffs_per_second<Thread::Atomic>()
+              << "  LightAtomic " << handoffs_per_second<Thread::LightAtomic>()
+              << "  SeqAtomic " << handoffs_per_second<Thread::SeqAtomic>() << std::endl;
+
+    // keep the loops from being optimized away
+    if (checksum == 1)
+        std::cerr << checksum;
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "HashMap.hpp"
+#include "LockFreeMap.hpp"
+#include "State.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Throughput of the transposition tables shared by 1 to N threads, with
+// nine probes for every update, as Evaluator::search does roughly.
+
+struct entry
+{
+    double score = 0;
+    int evaluated_depth = 0;
+};
+
+const size_t OPERATIONS = 1 << 20; // per thread
+
+template< typename Probe, typename Update >
+double operations_per_second (size_t num_of_threads, const std::vector<int> &keys, Probe probe, Update update)
+{
+    std::vector<std::thread> threads;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < num_of_threads; ++t)
+        threads.push_back(std::thread([&, t]() {
+            size_t i = t * 7919;
+            for (size_t n = 0; n < OPERATIONS; ++n, ++i)
+            {
+                const int key = keys[i % keys.size()];
+                if (n % 10)
+                    probe(key);
+                else
+                    update(key);
+            }
+        }));
+    for (auto &thread : threads)
+        thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return num_of_threads * OPERATIONS / elapsed.count();
+}
+
+int main()
+{
+    const int size = state::hash_count();
+    const size_t max_threads = std::max(4u, 2 * std::thread::hardware_concurrency());
+
+    std::vector<int> keys;
+    for (int hash = 0; hash < size; ++hash)
+        keys.push_back(hash);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(12345));
+
+    // HashMap inserts are not safe against concurrent lookups, so all keys go in beforehand
+    Thread::HashMap<int, entry> hash_map;
+    Thread::LockFreeMap<entry> lock_free_map(2 * size);
+    for (int key : keys)
+    {
+        hash_map[key];
+        lock_free_map.set(key, entry());
+    }
+
+    std::cout << "threads  HashMap ops/sec  LockFreeMap ops/sec" << std::endl;
+
+    for (size_t num_of_threads = 1; num_of_threads <= max_threads; num_of_threads *= 2)
+    {
+        const double hash_map_ops = operations_per_second(num_of_threads, keys,
+            [&](int key) { hash_map[key].access([](const entry &e) { (void)e; }); },
+            [&](int key) { hash_map[key].mutate([](entry &e) { ++e.evaluated_depth; }); });
+
+        const double lock_free_map_ops = operations_per_second(num_of_threads, keys,
+            [&](int key) { entry e; lock_free_map.find(key, e); },
+            [&](int key) { lock_free_map.update(key, [](entry &e) { ++e.evaluated_depth; }); });
+
+        std::cout << num_of_threads << "  " << hash_map_ops << "  " << lock_free_map_ops << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "GenericRules.h"
+#include "GenericState.hpp"
+#include "Rules.hpp"
+#include "State.hpp"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+// Move generation of the table-driven generic state against the state
+// specialized at compile time, for every variant in Rules.hpp. Both have to
+// agree on every position: its hash, its moves and the hashes they lead to.
+// Then the variants only the generic state plays, with more players, more
+// hands or larger hands, are explored from their starting position.
+
+const int ROUNDS = 200;
+
+template< typename Generate >
+double seconds_per_round (Generate generate)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round)
+        generate();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / ROUNDS;
+}
+
+template< typename Policy >
+void compare (const char *name)
+{
+    typedef basic_state<Policy> specialized;
+
+    const Generic::Rules rules(Generic::rule_parameters::of<Policy>());
+    const int count = specialized::hash_count();
+
+    move_data specialized_moves[specialized::max_moves()];
+    specialized specialized_targets[specialized::max_moves()];
+    std::vector<Generic::move> generic_moves(rules.max_moves());
+    std::vector<Generic::state> generic_targets(rules.max_moves(), Generic::state(rules));
+
+    size_t mismatches = rules.hash_count() != count || rules.max_moves() > specialized::max_moves();
+    for (int hash = 0; hash < count && !mismatches; ++hash)
+    {
+        const specialized s = specialized::unpack(hash);
+        const Generic::state g = Generic::state::unpack(rules, hash);
+
+        if (g.pack() != (packed_state)hash || s.is_valid() != g.is_valid() || (s.is_valid() && s.is_over() != g.is_over()))
+        {
+            ++mismatches;
+            continue;
+        }
+
+        const int n = s.generate_moves(specialized_moves, specialized_targets);
+        if (n != g.generate_moves(generic_moves.data(), generic_targets.data()))
+        {
+            ++mismatches;
+            continue;
+        }
+
+        for (int i = 0; i < n; ++i)
+            mismatches += specialized_moves[i].get_code() != generic_moves[i].to_move_data().get_code() ||
+                          specialized_targets[i].pack() != generic_targets[i].pack();
+    }
+
+    // the valid states are unpacked once, and every round generates all their moves
+    std::vector<specialized> specialized_states;
+    std::vector<Generic::state> generic_states;
+    for (int hash = 0; hash < count; ++hash)
+        if (specialized::unpack(hash).is_valid())
+        {
+            specialized_states.push_back(specialized::unpack(hash));
+            generic_states.push_back(Generic::state::unpack(rules, hash));
+        }
+
+    // the hashes of the targets are summed up, so that nothing is optimized away
+    packed_state checksum = 0;
+
+    const double specialized_seconds = seconds_per_round([&]() {
+        for (const specialized &s : specialized_states)
+        {
+            const int n = s.generate_moves(specialized_moves, specialized_targets);
+            for (int i = 0; i < n; ++i)
+                checksum += specialized_targets[i].pack();
+        }
+    });
+
+    const double generic_seconds = seconds_per_round([&]() {
+        for (const Generic::state &g : generic_states)
+        {
+            const int n = g.generate_moves(generic_moves.data(), generic_targets.data());
+            for (int i = 0; i < n; ++i)
+                checksum += generic_targets[i].pack();
+        }
+    });
+
+    std::cout << name << "  "
+              << specialized_states.size() << "  "
+              << mismatches << "  "
+              << 1e9 * specialized_seconds / specialized_states.size() << "  "
+              << 1e9 * generic_seconds / generic_states.size() << "  "
+              << generic_seconds / specialized_seconds << std::endl;
+
+    // keep the loops from being optimized away
+    if (checksum == 1)
+        std::cout << checksum;
+}
+
+// every position reachable from the start, found breadth first
+void explore (const std::string &text)
+{
+    std::string name = text.empty() ? "standard" : text;
+    for (size_t i = name.find('\n'); i != std::string::npos; i = name.find('\n', i))
+        name.replace(i, 1, "; ");
+
+    try
+    {
+        const Generic::Rules rules(Generic::rule_parameters::parse(text));
+
+        std::vector<Generic::move> moves(rules.max_moves());
+        std::vector<Generic::state> targets(rules.max_moves(), Generic::state(rules));
+
+        std::vector<Generic::state> queue(1, Generic::state(rules));
+        std::unordered_set<Generic::packed_state> seen = { queue[0].pack() };
+
+        const auto start = std::chrono::steady_clock::now();
+        size_t generated = 0;
+
+        for (size_t i = 0; i < queue.size(); ++i)
+        {
+            const int n = queue[i].generate_moves(moves.data(), targets.data());
+            generated += n;
+
+            for (int j = 0; j < n; ++j)
+                if (seen.insert(targets[j].pack()).second)
+                    queue.push_back(targets[j]);
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << name << "  "
+                  << rules.hash_count() << "  "
+                  << queue.size() << "  "
+                  << generated << "  "
+                  << 1e9 * elapsed.count() / queue.size() << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << name << "  " << e.what() << std::endl;
+    }
+}
+
+int main()
+{
+    std::cout << "rules  states  mismatches  specialized ns/state  generic ns/state  ratio" << std::endl;
+
+#define COMPARE(Rules) compare<Rules>(#Rules);
+    CHOPSTICKS_RULES(COMPARE)
+
+    std::cout << std::endl << "rules  hashes  reachable states  moves  ns/state" << std::endl;
+
+    explore("");
+    explore("hand_max = 8");
+    explore("hand_max = 16");
+    explore("hands = 3");
+    explore("hands = 3\nhand_max = 8");
+    explore("players = 3");
+    explore("players = 3\nhand_max = 8");
+    explore("players = 4");
+    explore("players = 4\nhands = 4\nhand_max = 16");
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "Evaluator.h"
+#include "State.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Speedup and search overhead of the parallel search with 1 to 16 threads.
+// Every valid position is evaluated once by a fresh evaluator, without the
+// solver, and the searched states are summed up.
+
+struct result
+{
+    double seconds;
+    size_t states;
+};
+
+result evaluate_all (size_t num_of_threads, const std::vector<state> &positions)
+{
+    Evaluator evaluator(false, num_of_threads);
+    result ret = { 0, 0 };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const state &position : positions)
+    {
+        evaluator.evaluate_next_move(position);
+        ret.states += evaluator.get_last_number_of_evaluated_states();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    ret.seconds = elapsed.count();
+    return ret;
+}
+
+int main()
+{
+    std::vector<state> positions;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+    {
+        const state position = state::unpack(hash);
+        if (position.is_valid() && !position.is_over())
+            positions.push_back(position);
+    }
+
+    std::vector<std::pair<size_t, result> > results;
+    for (size_t num_of_threads = 1; num_of_threads <= 16; num_of_threads *= 2)
+        results.push_back(std::make_pair(num_of_threads, evaluate_all(num_of_threads, positions)));
+
+    const result &base = results.front().second;
+
+    std::cout << std::endl
+              << positions.size() << " positions" << std::endl
+              << "threads  seconds  speedup  states  overhead" << std::endl;
+
+    for (const auto &r : results)
+        std::cout << r.first << "  "
+                  << r.second.seconds << "  "
+                  << base.seconds / r.second.seconds << "  "
+                  << r.second.states << "  "
+                  << 100.0 * ((double)r.second.states / base.states - 1) << "%" << std::endl;
+
+    return 0;
+}
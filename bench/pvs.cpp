@@ -0,0 +1,134 @@
+#include "Evaluator.h"
+#include "Rules.hpp"
+#include "State.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Principal variation search against the plain full-window search, on the
+// positions the suite evaluates: the states searched and the time it takes
+// to reach every depth, with a fresh evaluator and one thread per position.
+// The effective branching factor is how many times more states one more ply
+// costs, over the last few plies; the agreement is how many positions end up
+// with the same score both ways, and with late move reductions as well.
+//
+// With reproducible scores, the agreement of the search without reductions
+// must be complete: every position that differs is a MISMATCH, and the exit
+// status is 1. Scores past the window of the root are only bounds, so they
+// are compared once brought back into it.
+
+const size_t POSITIONS = 256;
+const int DEPTHS[] = { 4, 8, 12, 16, 20, 24 };
+const int EBF_PLIES = 4; // the branching factor is taken over the plies from the previous depth
+
+struct totals
+{
+    size_t nodes = 0;
+    double seconds = 0;
+    std::vector<double> scores;
+};
+
+template< typename Rules >
+totals search_all (const std::vector<basic_state<Rules> > &positions, int depth, bool pvs, bool lmr, bool reproducible)
+{
+    totals ret;
+
+    for (const basic_state<Rules> &position : positions)
+    {
+        BasicEvaluator<Rules> evaluator(false, 1);
+
+        search_limits limits;
+        limits.depth = depth;
+        limits.pvs = pvs;
+        limits.lmr = lmr;
+        limits.reproducible = reproducible;
+
+        const auto start = std::chrono::steady_clock::now();
+        evaluator.evaluate_next_move(position, limits);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        ret.nodes += evaluator.get_last_number_of_evaluated_states();
+        ret.seconds += elapsed.count();
+        ret.scores.push_back(std::max(-ABS_SCORE, std::min(ABS_SCORE, evaluator.get_node_data(position).score)));
+    }
+
+    return ret;
+}
+
+size_t agreement (const totals &a, const totals &b)
+{
+    size_t ret = 0;
+    for (size_t i = 0; i < a.scores.size(); ++i)
+        ret += std::fabs(a.scores[i] - b.scores[i]) <= EPSILON;
+    return ret;
+}
+
+// returns the number of depths at which the reproducible scores differ
+template< typename Rules >
+int compare (const char *variant)
+{
+    typedef basic_state<Rules> state;
+
+    // the same spread of ongoing positions as the suite
+    std::vector<state> ongoing, positions;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+    {
+        const state position = state::unpack(hash);
+        if (position.is_valid() && !position.is_over())
+            ongoing.push_back(position);
+    }
+    for (size_t i = 0; i < POSITIONS && i < ongoing.size(); ++i)
+        positions.push_back(ongoing[i * ongoing.size() / std::min(POSITIONS, ongoing.size())]);
+
+    std::cout << variant << ", " << positions.size() << " positions" << std::endl
+              << "depth  plain states  pvs states  plain seconds  pvs seconds  plain ebf  pvs ebf  same score  same with lmr" << std::endl;
+
+    totals plain_before, pvs_before;
+    for (int depth : DEPTHS)
+    {
+        const totals plain = search_all<Rules>(positions, depth, false, false, false),
+                     pvs = search_all<Rules>(positions, depth, true, false, false),
+                     lmr = search_all<Rules>(positions, depth, true, true, false);
+
+        std::cout << depth << "  " << plain.nodes << "  " << pvs.nodes << "  " << plain.seconds << "  " << pvs.seconds << "  ";
+        if (plain_before.nodes)
+            std::cout << std::pow((double)plain.nodes / plain_before.nodes, 1.0 / EBF_PLIES) << "  "
+                      << std::pow((double)pvs.nodes / pvs_before.nodes, 1.0 / EBF_PLIES) << "  ";
+        else
+            std::cout << "-  -  ";
+        std::cout << agreement(plain, pvs) << "/" << positions.size() << "  " << agreement(plain, lmr) << "/" << positions.size() << std::endl;
+
+        plain_before = plain;
+        pvs_before = pvs;
+    }
+
+    std::cout << "reproducible scores" << std::endl
+              << "depth  plain states  pvs states  same score" << std::endl;
+
+    int failed = 0;
+    for (int depth : DEPTHS)
+    {
+        const totals plain = search_all<Rules>(positions, depth, false, false, true),
+                     pvs = search_all<Rules>(positions, depth, true, false, true);
+
+        const size_t same = agreement(plain, pvs);
+        std::cout << depth << "  " << plain.nodes << "  " << pvs.nodes << "  " << same << "/" << positions.size()
+                  << "  " << (same == positions.size() ? "OK" : "MISMATCH") << std::endl;
+
+        failed += same != positions.size();
+    }
+
+    return failed;
+}
+
+int main()
+{
+    int failed = 0;
+
+#define COMPARE(Rules) failed += compare<Rules>(#Rules);
+    CHOPSTICKS_RULES(COMPARE)
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,332 @@
+#include "Evaluator.h"
+#include "HashMap.hpp"
+#include "LightAtomic.hpp"
+#include "LockFreeMap.hpp"
+#include "Perft.hpp"
+#include "Rules.hpp"
+#include "State.hpp"
+#include "Thread.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The benchmark suite that tracks regressions: move generation, hashing,
+// the shared tables, the thread pool and whole evaluations, written as one
+// JSON document to the file given, or to stdout. Every result is one record
+// of a flat list, so that runs can be compared record by record:
+//   { "benchmark": ..., "variant": ..., "threads": ..., "value": ..., "unit": ... }
+
+const int ROUNDS = 100;                  // passes over every valid state
+const size_t OPERATIONS = 1 << 20;       // per thread, on the shared tables
+const size_t TASKS = 1 << 18;            // per pool
+const size_t POSITIONS = 256;            // evaluated per variant and number of threads
+const int PERFT_DEPTH = 9;               // from the start
+
+class json_results
+{
+private:
+    std::ostringstream records;
+    size_t count = 0;
+
+public:
+    void add (const std::string &benchmark, const std::string &variant, size_t threads, double value, const std::string &unit)
+    {
+        records << (count++ ? ",\n" : "\n")
+                << "    { \"benchmark\": \"" << benchmark << "\", \"variant\": \"" << variant << "\", "
+                << "\"threads\": " << threads << ", \"value\": " << value << ", \"unit\": \"" << unit << "\" }";
+
+        // progress goes to stderr, so that stdout stays a valid document
+        std::cerr << benchmark << "  " << variant << "  " << threads << "  " << value << " " << unit << std::endl;
+    }
+
+    std::string str() const
+    {
+        std::ostringstream oss;
+        oss << "{\n"
+            << "  \"suite\": \"chopsticks\",\n"
+            << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"results\": [" << records.str() << "\n  ]\n"
+            << "}\n";
+        return oss.str();
+    }
+};
+
+template< typename Func >
+double seconds_of (Func func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// runs body(thread index) on num_of_threads threads at once
+template< typename Body >
+double parallel_seconds (size_t num_of_threads, Body body)
+{
+    return seconds_of([&]() {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_of_threads; ++t)
+            threads.push_back(std::thread(body, t));
+        for (auto &thread : threads)
+            thread.join();
+    });
+}
+
+// keeps the loops from being optimized away
+static std::atomic<size_t> checksum(0);
+
+template< typename Rules >
+void bench_state (json_results &results, const char *variant)
+{
+    typedef basic_state<Rules> state;
+
+    std::vector<state> states;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+        if (state::unpack(hash).is_valid())
+            states.push_back(state::unpack(hash));
+
+    move_data moves[state::max_moves()];
+    state targets[state::max_moves()];
+    size_t generated = 0, sum = 0;
+
+    const double generation = seconds_of([&]() {
+        for (int round = 0; round < ROUNDS; ++round)
+            for (const state &s : states)
+            {
+                const int n = s.generate_moves(moves, targets);
+                generated += n;
+                for (int i = 0; i < n; ++i)
+                    sum += targets[i].pack();
+            }
+    });
+    results.add("state.generate_moves", variant, 1, generated / generation, "moves/s");
+
+    const double encoding = seconds_of([&]() {
+        for (int round = 0; round < ROUNDS; ++round)
+            for (const state &s : states)
+                sum += s.pack();
+    });
+    results.add("state.pack", variant, 1, ROUNDS * states.size() / encoding, "states/s");
+
+    const double decoding = seconds_of([&]() {
+        for (int round = 0; round < ROUNDS; ++round)
+            for (int hash = 0; hash < state::hash_count(); ++hash)
+                sum += state::unpack(hash).white_left_hand;
+    });
+    results.add("state.unpack", variant, 1, ROUNDS * state::hash_count() / decoding, "states/s");
+
+    const double canonical = seconds_of([&]() {
+        for (int round = 0; round < ROUNDS; ++round)
+            for (const state &s : states)
+                sum += s.get_canonical_hash();
+    });
+    results.add("state.get_canonical_hash", variant, 1, ROUNDS * states.size() / canonical, "states/s");
+
+    uint64_t leaves = 0;
+    const double perft = seconds_of([&]() { leaves = BasicPerft<Rules>::perft(state(), PERFT_DEPTH); });
+    results.add("perft", variant, 1, leaves / perft, "leaves/s");
+    sum += leaves;
+
+    checksum += sum;
+}
+
+template< typename Rules >
+void bench_search (json_results &results, const char *variant, size_t num_of_threads)
+{
+    typedef basic_state<Rules> state;
+
+    // the same spread of ongoing positions every run
+    std::vector<state> ongoing, positions;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+    {
+        const state position = state::unpack(hash);
+        if (position.is_valid() && !position.is_over())
+            ongoing.push_back(position);
+    }
+    for (size_t i = 0; i < POSITIONS && i < ongoing.size(); ++i)
+        positions.push_back(ongoing[i * ongoing.size() / std::min(POSITIONS, ongoing.size())]);
+
+    // a cold search of every position, by a fresh evaluator without the solver;
+    // starting the evaluator is not timed
+    size_t searched = 0;
+    double seconds = 0;
+    for (const state &position : positions)
+    {
+        BasicEvaluator<Rules> evaluator(false, num_of_threads);
+
+        seconds += seconds_of([&]() { evaluator.evaluate_next_move(position); });
+        searched += evaluator.get_last_number_of_evaluated_states();
+    }
+
+    results.add("evaluator.evaluate_next_move", variant, num_of_threads, 1e3 * seconds / positions.size(), "ms/position");
+    results.add("evaluator.nodes", variant, num_of_threads, searched / seconds, "nodes/s");
+}
+
+struct entry
+{
+    double score = 0;
+    int evaluated_depth = 0;
+};
+
+template< typename Cell >
+void bench_atomic (json_results &results, const char *name, size_t num_of_threads)
+{
+    Cell shared(0);
+
+    const double get = parallel_seconds(num_of_threads, [&](size_t) {
+        size_t sum = 0;
+        for (size_t n = 0; n < OPERATIONS; ++n)
+            sum += shared.get();
+        checksum += sum;
+    });
+    results.add(std::string(name) + ".get", "", num_of_threads, num_of_threads * OPERATIONS / get, "ops/s");
+
+    // every set changes the value, so that none of them is skipped
+    const double set = parallel_seconds(num_of_threads, [&](size_t t) {
+        for (size_t n = 0; n < OPERATIONS; ++n)
+            shared.set(t * OPERATIONS + n + 1);
+    });
+    results.add(std::string(name) + ".set", "", num_of_threads, num_of_threads * OPERATIONS / set, "ops/s");
+}
+
+void bench_tables (json_results &results, size_t num_of_threads, const std::vector<int> &keys)
+{
+    // HashMap inserts are not safe against concurrent lookups, so they are timed on one thread
+    if (num_of_threads == 1)
+    {
+        Thread::HashMap<int, entry> hash_map;
+        const double insert = seconds_of([&]() {
+            for (int key : keys)
+                hash_map[key];
+        });
+        results.add("HashMap.insert", "", 1, keys.size() / insert, "ops/s");
+    }
+
+    Thread::HashMap<int, entry> hash_map;
+    for (int key : keys)
+        hash_map[key];
+
+    const double lookup = parallel_seconds(num_of_threads, [&](size_t t) {
+        double sum = 0;
+        for (size_t n = 0, i = t * 7919; n < OPERATIONS; ++n, ++i)
+            hash_map[keys[i % keys.size()]].access([&](const entry &e) { sum += e.score; });
+        checksum += sum;
+    });
+    results.add("HashMap.lookup", "", num_of_threads, num_of_threads * OPERATIONS / lookup, "ops/s");
+
+    Thread::LockFreeMap<entry> lock_free_map(2 * keys.size());
+
+    // every thread inserts its own share of the keys
+    const double insert = parallel_seconds(num_of_threads, [&](size_t t) {
+        for (size_t i = t; i < keys.size(); i += num_of_threads)
+            lock_free_map.set(keys[i], entry());
+    });
+    results.add("LockFreeMap.insert", "", num_of_threads, keys.size() / insert, "ops/s");
+
+    const double find = parallel_seconds(num_of_threads, [&](size_t t) {
+        entry e;
+        size_t found = 0;
+        for (size_t n = 0, i = t * 7919; n < OPERATIONS; ++n, ++i)
+            found += lock_free_map.find(keys[i % keys.size()], e);
+        checksum += found;
+    });
+    results.add("LockFreeMap.find", "", num_of_threads, num_of_threads * OPERATIONS / find, "ops/s");
+
+    const double update = parallel_seconds(num_of_threads, [&](size_t t) {
+        for (size_t n = 0, i = t * 7919; n < OPERATIONS; ++n, ++i)
+            lock_free_map.update(keys[i % keys.size()], [](entry &e) { ++e.evaluated_depth; });
+    });
+    results.add("LockFreeMap.update", "", num_of_threads, num_of_threads * OPERATIONS / update, "ops/s");
+}
+
+void bench_pool (json_results &results, size_t num_of_threads)
+{
+    Thread::ThreadPool pool(num_of_threads);
+    std::atomic<size_t> done(0);
+
+    const double spawn = seconds_of([&]() {
+        for (size_t n = 0; n < TASKS; ++n)
+            pool.spawn([&]() { done.fetch_add(1, std::memory_order_relaxed); });
+        pool.wait();
+    });
+    results.add("ThreadPool.spawn", "", num_of_threads, TASKS / spawn, "tasks/s");
+
+    const double add = seconds_of([&]() {
+        std::vector<std::future<size_t> > futures;
+        futures.reserve(TASKS);
+        for (size_t n = 0; n < TASKS; ++n)
+            futures.push_back(pool.add([n]() { return n; }));
+        for (auto &future : futures)
+            done += future.get();
+    });
+    results.add("ThreadPool.add", "", num_of_threads, TASKS / add, "tasks/s");
+
+    const double add_range = seconds_of([&]() {
+        pool.add_range(0, TASKS, [&](size_t i) { done.fetch_add(i, std::memory_order_relaxed); });
+        pool.wait();
+    });
+    results.add("ThreadPool.add_range", "", num_of_threads, TASKS / add_range, "tasks/s");
+
+    checksum += done;
+}
+
+int main (int argc, char **argv)
+{
+    json_results results;
+
+    std::vector<size_t> thread_counts;
+    const size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (size_t num_of_threads = 1; num_of_threads <= max_threads; num_of_threads *= 2)
+        thread_counts.push_back(num_of_threads);
+
+#define BENCH_STATE(Rules) bench_state<Rules>(results, #Rules);
+    CHOPSTICKS_RULES(BENCH_STATE)
+
+    std::vector<int> keys;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+        keys.push_back(hash);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(12345));
+
+    for (size_t num_of_threads : thread_counts)
+    {
+        bench_atomic<Thread::Atomic<size_t> >(results, "Atomic", num_of_threads);
+        bench_atomic<Thread::LightAtomic<size_t> >(results, "LightAtomic", num_of_threads);
+        bench_atomic<Thread::SeqAtomic<size_t> >(results, "SeqAtomic", num_of_threads);
+        bench_tables(results, num_of_threads, keys);
+        bench_pool(results, num_of_threads);
+    }
+
+    for (size_t num_of_threads : thread_counts)
+    {
+#define BENCH_SEARCH(Rules) bench_search<Rules>(results, #Rules, num_of_threads);
+        CHOPSTICKS_RULES(BENCH_SEARCH)
+    }
+
+    if (argc > 1)
+    {
+        std::ofstream out(argv[1]);
+        out << results.str();
+        if (!out)
+        {
+            std::cerr << "Cannot write " << argv[1] << std::endl;
+            return 1;
+        }
+    }
+    else
+        std::cout << results.str();
+
+    // keep the loops from being optimized away
+    if (checksum == 1)
+        std::cerr << checksum;
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "Evaluator.h"
+#include "State.hpp"
+#include <iostream>
+#include <set>
+#include <vector>
+
+// Size of the search space under the left/right hand symmetries. Every valid
+// position is evaluated once by a fresh evaluator, without the solver, and
+// the searched and stored states are summed up, once with mirrored states
+// kept apart and once with them merged into their canonical state.
+
+struct totals
+{
+    size_t searched = 0, stored = 0;
+};
+
+totals search_all (const std::vector<state> &positions, bool use_symmetry)
+{
+    totals ret;
+
+    for (const state &position : positions)
+    {
+        Evaluator evaluator(false, 1, use_symmetry);
+        evaluator.evaluate_next_move(position);
+
+        ret.searched += evaluator.get_last_number_of_evaluated_states();
+        ret.stored += evaluator.get_number_of_stored_states();
+    }
+
+    return ret;
+}
+
+int main()
+{
+    std::vector<state> positions;
+    std::set<int> classes;
+    int valid = 0;
+
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+    {
+        const state position = state::unpack(hash);
+        if (!position.is_valid())
+            continue;
+
+        ++valid;
+        classes.insert(position.get_canonical_hash());
+
+        if (!position.is_over())
+            positions.push_back(position);
+    }
+
+    const totals plain = search_all(positions, false), canonical = search_all(positions, true);
+
+    std::cout << std::endl
+              << valid << " valid states in " << classes.size() << " canonical classes" << std::endl
+              << positions.size() << " positions" << std::endl
+              << "                 without symmetry  with symmetry" << std::endl
+              << "searched states  " << plain.searched << "  " << canonical.searched << std::endl
+              << "stored states    " << plain.stored << "  " << canonical.stored << std::endl;
+
+    return 0;
+}
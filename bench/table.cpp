@@ -0,0 +1,59 @@
+#include "DenseMap.hpp"
+#include "HashMap.hpp"
+#include "State.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Lookups per second of the transposition table, keyed by state hashes the
+// same way Evaluator::search does.
+
+struct entry
+{
+    double score = 0;
+    int evaluated_depth = 0;
+};
+
+template< typename Table >
+double lookups_per_second (Table &table, const std::vector<int> &keys, size_t rounds)
+{
+    double checksum = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round)
+        for (int key : keys)
+            table[key].access([&](const entry &e) { checksum += e.score; });
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // keep the loop from being optimized away
+    if (checksum < 0)
+        std::cout << checksum;
+
+    return keys.size() * rounds / elapsed.count();
+}
+
+int main()
+{
+    const int size = state::hash_count();
+    const size_t rounds = 200;
+
+    std::vector<int> keys;
+    for (int hash = 0; hash < size; ++hash)
+        keys.push_back(hash);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(12345));
+
+    Thread::HashMap<int, entry> hash_map;
+    Thread::DenseMap<entry> dense_map(size);
+    for (int key : keys)
+    {
+        hash_map[key];
+        dense_map[key];
+    }
+
+    std::cout << "HashMap:  " << lookups_per_second(hash_map, keys, rounds) << " lookups/sec" << std::endl
+              << "DenseMap: " << lookups_per_second(dense_map, keys, rounds) << " lookups/sec" << std::endl;
+
+    return 0;
+}
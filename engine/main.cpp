@@ -0,0 +1,173 @@
+#include "Evaluator.h"
+#include "Move.hpp"
+#include "State.hpp"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// The engine without the console: evaluates every position given on the
+// command line, or one position per line of stdin if none is given, and
+// prints one line of results for each. A position is a game hash, or the
+// moves played from the start, such as "LR SR1 RL"; "start" is the start.
+
+#define BOOK_FILE "chopsticks.book"
+
+static void usage()
+{
+    std::cerr << "Usage: chopsticks-engine [options] [position...]" << std::endl
+              << "  --depth N      deepest iteration, " << EVALUATION_DEPTH << " by default" << std::endl
+              << "  --seconds S    time per position, no limit by default" << std::endl
+              << "  --states N     states searched per position, no limit by default" << std::endl
+              << "  --threads N    search threads, one per core by default" << std::endl
+              << "  --book PATH    solution book to map, " << BOOK_FILE << " by default" << std::endl
+              << "  --no-solver    search every position instead of solving the game first" << std::endl
+              << "  --pvs          principal variation search" << std::endl
+              << "  --lmr          late move reductions, with --pvs" << std::endl
+              << "  --stats        also print the counters of every search" << std::endl;
+}
+
+static state parse_position (const std::string &text)
+{
+    std::istringstream in(text);
+    std::string token;
+    state position;
+
+    if (text.find_first_not_of("0123456789 \t\r") == std::string::npos && in >> token)
+        return state::parse_hash(std::stoi(token));
+
+    while (in >> token)
+    {
+        if (token == "start")
+            continue;
+
+        const move_data move = move_data::parse_displayable(token);
+        if (move.is_split)
+            position.make_split_move(move.fparam, move.sparam);
+        else
+            position.make_move(move.fparam, move.sparam);
+    }
+
+    return position;
+}
+
+static void print_stats (const search_stats &stats)
+{
+    std::cout << " probes=" << stats.table_probes
+              << " hits=" << stats.table_hits
+              << " table_cutoffs=" << stats.table_cutoffs
+              << " cycles=" << stats.cycles
+              << " cutoffs=";
+    for (size_t i = 0; i < stats.cutoffs_by_move.size(); ++i)
+        std::cout << (i ? "," : "") << stats.cutoffs_by_move[i];
+
+    std::cout << " depth_seconds=";
+    for (size_t i = 0; i < stats.depth_seconds.size(); ++i)
+        std::cout << (i ? "," : "") << stats.depth_seconds[i];
+
+    std::cout << " seconds=" << stats.seconds
+              << " idle_seconds=" << stats.idle_seconds;
+}
+
+static void evaluate (Evaluator &evaluator, const std::string &text, const search_limits &limits, bool stats)
+{
+    const state position = parse_position(text);
+
+    if (position.is_over())
+    {
+        std::cout << "hash=" << position.get_hash() << " winner=" << (position.get_winner() == 'W' ? "white" : "black") << std::endl;
+        return;
+    }
+
+    evaluator.evaluate_next_move(position, limits);
+    const node_data node = evaluator.get_node_data(position);
+
+    std::cout << "hash=" << position.get_hash()
+              << " move=" << node.best_move.get_displayable()
+              << " score=" << node.score
+              << " depth=" << node.evaluated_depth
+              << " proven=" << (node.proven ? "yes" : "no")
+              << " distance=" << node.distance
+              << " states=" << evaluator.get_last_number_of_evaluated_states();
+    if (stats)
+        print_stats(evaluator.get_search_stats());
+    std::cout << std::endl;
+}
+
+int main (int argc, char **argv)
+{
+    search_limits limits;
+    size_t num_of_threads = 0;
+    std::string book = BOOK_FILE;
+    bool use_solver = true;
+    bool stats = false;
+    std::vector<std::string> positions;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--depth" && has_value)
+            limits.depth = atoi(argv[++i]);
+        else if (arg == "--seconds" && has_value)
+            limits.seconds = atof(argv[++i]);
+        else if (arg == "--states" && has_value)
+            limits.states = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && has_value)
+            num_of_threads = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--book" && has_value)
+            book = argv[++i];
+        else if (arg == "--no-solver")
+            use_solver = false;
+        else if (arg == "--pvs")
+            limits.pvs = true;
+        else if (arg == "--lmr")
+            limits.lmr = true;
+        else if (arg == "--stats")
+            stats = true;
+        else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-')
+        {
+            usage();
+            return 2;
+        }
+        else
+            positions.push_back(arg);
+    }
+
+    Evaluator evaluator(use_solver, num_of_threads);
+
+    try
+    {
+        evaluator.load_book(book);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+
+    const bool from_stdin = positions.empty();
+    std::string line;
+    int failed = 0;
+
+    for (size_t i = 0; from_stdin ? (bool)std::getline(std::cin, line) : i < positions.size(); ++i)
+    {
+        const std::string &text = from_stdin ? line : positions[i];
+        if (from_stdin && text.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        try
+        {
+            evaluate(evaluator, text, limits, stats);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "error=\"" << e.what() << "\"" << std::endl;
+            ++failed;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "Move.hpp"
+#include "Rules.hpp"
+#include "Solver.h"
+#include "State.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#define BOOK_VERSION 1
+
+// The file starts with this header, followed by one entry per state hash.
+// Both are written in the byte order of the machine that wrote them.
+class book_header
+{
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    int16_t hand_max[4];  // white left, white right, black left, black right
+    int16_t split_max[2]; // white, black
+    uint8_t splits_as_moves;
+    uint8_t allow_sacrifical_splits;
+    uint8_t allow_regenerative_splits;
+    uint8_t meta_variant;
+    uint32_t hash_count;
+};
+
+class book_entry
+{
+public:
+    char winner;         // 'W', 'B' or 'D', and 0 for states that are not in the book
+    move_code best_move;
+    int16_t distance;    // plies until the game ends under perfect play, -1 for draws
+};
+
+static_assert(sizeof(book_header) == 36, "Book header must have no padding");
+static_assert(sizeof(book_entry) == 4, "Book entry must have no padding");
+
+// A solution book mapped into memory. Lookups read the mapped entries in
+// place, so opening a book costs nothing but the mapping itself.
+template< typename Rules >
+class BasicBook
+{
+public:
+    typedef basic_state<Rules> state;
+    typedef BasicSolver<Rules> Solver;
+
+private:
+    const char *data = nullptr;
+    size_t length = 0;
+    const book_entry *entries = nullptr;
+
+#ifdef _WIN32
+    void *file = nullptr, *mapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+    static book_header expected_header();
+
+public:
+    BasicBook() {}
+    ~BasicBook();
+
+    // non-copyable
+    BasicBook (const BasicBook&) = delete;
+    BasicBook& operator= (const BasicBook&) = delete;
+
+    static void write (const std::string &path, const Solver &solver);
+
+    // false if there is no such file; throws if the file is not a book for the rules in state
+    bool open (const std::string &path);
+    void close();
+
+    bool is_open() const;
+    bool has_state (int hash_state) const;
+    size_t number_of_states() const;
+    solved_node_data get_node_data (int hash_state) const;
+};
+
+typedef BasicBook<standard_rules> Book;
+
+#endif // BOOK_H
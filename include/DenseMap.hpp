@@ -0,0 +1,121 @@
+#ifndef DENSEMAP_HPP_INCLUDED
+#define DENSEMAP_HPP_INCLUDED
+
+#include "LightAtomic.hpp"
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Thread
+{
+    // a map from the dense key range [0, size) onto a flat array, so a lookup is
+    // a single index computation; every entry lies on its own cache line
+    template< typename V >
+    class DenseMap
+    {
+    private:
+        struct alignas(64) slot
+        {
+            LightAtomic<V> value;
+            std::atomic<bool> used;
+
+            slot(): used(false) {}
+        };
+
+        size_t _size;
+        char *buffer;
+        slot *slots;
+
+        void check_key (int key) const
+        {
+            if (key < 0 || (size_t)key >= _size)
+                throw std::runtime_error("Key is out of the range of the dense map");
+        }
+
+    public:
+        DenseMap (size_t __size): _size(__size)
+        {
+            // operator new only guarantees alignof(std::max_align_t), so align by hand
+            size_t space = sizeof(slot) * _size + alignof(slot);
+            buffer = new char[space];
+
+            void *ptr = buffer;
+            slots = static_cast<slot*>(std::align(alignof(slot), sizeof(slot) * _size, ptr, space));
+
+            for (size_t i = 0; i < _size; ++i)
+                new (slots + i) slot();
+        }
+
+        ~DenseMap()
+        {
+            for (size_t i = 0; i < _size; ++i)
+                slots[i].~slot();
+            delete[] buffer;
+        }
+
+        // non-copyable
+        DenseMap (const DenseMap&) = delete;
+        DenseMap& operator= (const DenseMap&) = delete;
+
+        LightAtomic<V>& operator[] (int key)
+        {
+            check_key(key);
+            slots[key].used.store(true, std::memory_order_relaxed);
+            return slots[key].value;
+        }
+
+        LightAtomic<V>& operator[] (int key) const
+        {
+            if (!has_key(key))
+                throw std::runtime_error("Accessing unknown key in constant dense map is not allowed");
+            return slots[key].value;
+        }
+
+        bool has_key (int key) const
+        {
+            return key >= 0 && (size_t)key < _size && slots[key].used.load(std::memory_order_relaxed);
+        }
+
+        void clear()
+        {
+            for (size_t i = 0; i < _size; ++i)
+                if (slots[i].used.load(std::memory_order_relaxed))
+                {
+                    slots[i].~slot();
+                    new (slots + i) slot();
+                }
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        std::vector<int> keys() const
+        {
+            std::vector<int> ret;
+
+            for (size_t i = 0; i < _size; ++i)
+                if (slots[i].used.load(std::memory_order_relaxed))
+                    ret.push_back(i);
+
+            return ret;
+        }
+
+        std::vector<std::pair<int, V> > entities() const
+        {
+            std::vector<std::pair<int, V> > ret;
+
+            for (size_t i = 0; i < _size; ++i)
+                if (slots[i].used.load(std::memory_order_relaxed))
+                    ret.push_back(std::make_pair((int)i, slots[i].value.get()));
+
+            return ret;
+        }
+    };
+}
+
+#endif // DENSEMAP_HPP_INCLUDED
@@ -1,10 +1,19 @@
 #ifndef EVALUATOR_H
 #define EVALUATOR_H
 
-#include "HashMap.hpp"
+#include "Book.h"
+#include "GameGraph.h"
+#include "LockFreeMap.hpp"
+#include "Move.hpp"
+#include "Rules.hpp"
+#include "Solver.h"
 #include "State.hpp"
 #include "Thread.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -13,146 +22,329 @@
 
 #define EPSILON 1e-6
 
-#define EVALUATION_DEPTH 24   // depth of minimax evaluation
+#define EVALUATION_DEPTH 24   // deepest iteration of minimax evaluation, unless asked otherwise
+#define MAX_DEPTH        64   // deepest iteration that may be asked for
 #define ABS_SCORE        5.0  // winning states are evaluated +ABS_RANGE, losing states -ABS_RANGE
 #define SCORE_RANGE      10.0 // scores may not exceed this range at all cost
 #define SPLIT_PENALTY    0.2  // maximum penalty for split (if splits are limited)
+#define SPLIT_DEPTH      4    // nodes with at least this many plies left search their younger brothers in parallel
+#define ASPIRATION_WINDOW 0.25 // half-width of the window around the score of the previous iteration
+#define HISTORY_MAX      65536 // the history of a side is halved once one of its moves reaches this
+#define NULL_WINDOW      (4 * EPSILON) // width of the windows that only tell whether a move is better
+#define LMR_MOVES        2     // moves ordered at least this late are searched a ply shallower first, if quiet
+#define LMR_DEPTH        3     // nodes with at least this many plies left reduce their late moves
 
-enum evaluation_state
+class node_data
 {
-    MOVE_EVALUATED = 2,
-    MOVE_EVALUATING = 1,
-    MOVE_TO_BE_EVALUATED = 0
+public:
+    double score = 0;
+    int evaluated_depth = 0;
+    move_data best_move;
+    bool proven = false; // solved exactly rather than searched
+    int distance = -1;   // plies until the game ends under perfect play, -1 for draws or unproven states
 };
 
-class move_data
+// Limits of one evaluation. The search deepens one ply at a time up to depth,
+// and once the time or the number of evaluated states runs out, the last
+// completed iteration is kept. The first iteration always completes.
+class search_limits
 {
 public:
-    int fparam, sparam;
-    bool is_split;
+    int depth = EVALUATION_DEPTH;
+    double seconds = 0; // 0 for no deadline
+    size_t states = 0;  // 0 for no budget
 
-    move_data (int _fparam = 0, int _sparam = 0, bool _is_split = false):
-        fparam(_fparam), sparam(_sparam), is_split(_is_split) {}
+    // principal variation search: every move but the first is only shown to be no
+    // better with a null window, and searched again with the full window if it
+    // is. Without lmr it finds the scores of the plain search exactly with
+    // reproducible scores, and nearly always otherwise. Off by default, as the
+    // table already settles most nodes in this game; bench/pvs compares the two
+    bool pvs = false;
 
-    std::string get_displayable() const
-    {
-        if (is_split)
-            return std::string("S") +
-                   (fparam < 0 ? "R" : fparam == 0 ? "-" : sparam < 0 ? "L" : "-") +
-                   (abs(fparam) == abs(sparam) ? std::to_string(abs(fparam)) : "-");
-        else
-            return std::string("") +
-                   (toupper(fparam) == 'L' || toupper(fparam) == 'R' ?
-                   (char)toupper(fparam) : '-') +
-                   (toupper(sparam) == 'L' || toupper(sparam) == 'R' ?
-                   (char)toupper(sparam) : '-');
-    }
+    // late move reductions, with pvs only: late quiet moves are shown to be no
+    // better a ply shallower, which may change the scores
+    bool lmr = false;
 
-    static move_data parse_displayable(std::string displayable)
-    {
-        static const std::string error_msg = "Move parsing failed: Invalid displayable format";
-        move_data move;
+    // scores that only depend on the position and the depth: moves that lead
+    // back into the path are left out, so the plain search and pvs may settle
+    // a node differently once the table hands them the score of another path
+    // or depth. Here the table only answers for the same depth and for scores
+    // that left out no moves into the path above them, and no move keeps its
+    // result for the rest of the iteration. pvs without lmr then finds exactly
+    // the scores of the plain search, at several times the states
+    bool reproducible = false;
+};
 
-        for (size_t i = 0; i < displayable.length(); ++i)
-            displayable[i] = toupper(displayable[i]);
+// Counters of the running or the last evaluation, summed over the threads
+// when the snapshot is taken. Pondering counts into the evaluation it follows.
+class search_stats
+{
+public:
+    size_t nodes = 0;         // states searched
+    size_t table_probes = 0;  // lookups of the transposition table
+    size_t table_hits = 0;    // lookups that found the state
+    size_t table_cutoffs = 0; // hits searched deep enough, with a score that settles the node
+    size_t cycles = 0;        // moves skipped because their state is on the path already
 
-        if (displayable.length() < 2)
-            throw std::runtime_error(error_msg);
-        else
-        if (displayable.length() == 2)
-        {
-            if (displayable[0] == 'L')
-                move.fparam = 'L';
-            else
-            if (displayable[0] == 'R')
-                move.fparam = 'R';
-            else
-                throw std::runtime_error(error_msg);
-
-            if (displayable[1] == 'L')
-                move.sparam = 'L';
-            else
-            if (displayable[1] == 'R')
-                move.sparam = 'R';
-            else
-                throw std::runtime_error(error_msg);
-        }
-        else
-        {
-            if (displayable[0] != 'S')
-                throw std::runtime_error(error_msg);
-            if (displayable[1] != 'L' && displayable[1] != 'R')
-                throw std::runtime_error(error_msg);
-
-            move.fparam = displayable[1] == 'L' ? 1 : -1;
-            move.sparam = displayable[1] == 'R' ? 1 : -1;
-
-            const int change = std::stoi(displayable.substr(2));
-            move.fparam *= change;
-            move.sparam *= change;
-            move.is_split = true;
-        }
+    // by the index of the move that caused them, in the order moves are searched;
+    // the more cutoffs on the first move, the better the moves are ordered
+    std::vector<size_t> cutoffs_by_move;
 
-        if (!move.is_valid())
-            throw std::runtime_error(error_msg);
+    std::vector<double> depth_seconds; // of every completed iteration, deepest last
+    double seconds = 0;                // since the evaluation started
 
-        return move;
+    size_t waiting_tasks = 0; // queued in the pool when the snapshot was taken
+    double idle_seconds = 0;  // the pool threads spent asleep since the evaluation started
+
+    size_t cutoffs() const
+    {
+        size_t ret = 0;
+        for (size_t count : cutoffs_by_move)
+            ret += count;
+        return ret;
     }
 
-    bool is_valid() const
+    double first_move_cutoff_rate() const
     {
-        return is_split ? (fparam != 0 && fparam == -sparam) :
-                         ((toupper(fparam) == 'L' || toupper(fparam) == 'R') &&
-                          (toupper(sparam) == 'L' || toupper(sparam) == 'R'));
+        return cutoffs_by_move.empty() || !cutoffs() ? 0 : (double)cutoffs_by_move[0] / cutoffs();
     }
 };
 
-class node_data
+template< typename Rules >
+class BasicEvaluator
 {
 public:
-    double score = 0;
-    int evaluated_depth = 0;
-    move_data best_move;
-};
+    typedef basic_state<Rules> state;
+    typedef BasicGameGraph<Rules> GameGraph;
+    typedef BasicSolver<Rules> Solver;
+    typedef BasicBook<Rules> Book;
 
-class Evaluator
-{
 private:
     class evaluating_node_data : public node_data
     {
     public:
         double alpha = -SCORE_RANGE, beta = SCORE_RANGE;
-        Thread::HashMap<std::string, evaluation_state> moves;
-        bool evaluated_marker = false;
+        unsigned generation = 0;
+        uint64_t evaluated_moves = 0; // a bit per move code, for the moves searched in this generation
+
+        // the score left out moves back into the path it was searched on, at plies from cycle_ply
+        bool cyclic = false;
+        size_t cycle_ply = MAX_DEPTH;
+
+        static_assert(state::max_move_codes() <= 64, "Move codes do not fit in the evaluated moves mask");
     };
 
-    Thread::HashMap<int, evaluating_node_data> table;
-    Thread::HashMap<std::string, bool> in_stack;
-    bool evaluated_marker = false;
+    // states on the path from the root to the node being searched; every task owns its own copy
+    class search_path
+    {
+    private:
+        std::vector<bool> on_path;
+        std::vector<int> hashes;
+        std::vector<const Thread::TaskGroup*> splits; // the brothers of the split points above
+
+    public:
+        search_path (int size): on_path(size, false) {}
+
+        bool empty() const
+        {
+            return hashes.empty();
+        }
+
+        bool contains (int hash) const
+        {
+            return on_path[hash];
+        }
+
+        void push (int hash)
+        {
+            on_path[hash] = true;
+            hashes.push_back(hash);
+        }
+
+        void pop()
+        {
+            on_path[hashes.back()] = false;
+            hashes.pop_back();
+        }
+
+        // the ply of the node about to be pushed
+        size_t size() const
+        {
+            return hashes.size();
+        }
+
+        // the ply of a state on the path
+        size_t ply_of (int hash) const
+        {
+            return std::find(hashes.begin(), hashes.end(), hash) - hashes.begin();
+        }
+
+        // a task below the split point of brothers
+        void split (const Thread::TaskGroup &brothers)
+        {
+            splits.push_back(&brothers);
+        }
+
+        // a brother has cut off a split point above, so the rest of this subtree is not needed
+        bool cancelled() const
+        {
+            return std::any_of(splits.begin(), splits.end(), [](const Thread::TaskGroup *brothers) {
+                return brothers->is_cancelled();
+            });
+        }
+    };
+
+    // the moves of a node being searched are folded in here, by several tasks at once below a split point
+    class search_node
+    {
+    public:
+        std::atomic<double> alpha, beta; // read without locking by the brothers about to start
+        std::mutex mutex;                // guards the rest
+        double score;
+        bool improved = false;
+        move_code best_move = 0;
+        uint64_t evaluated_moves = 0;
+        size_t cycle_ply = MAX_DEPTH; // the shallowest ply on the path that a move left out led back to
+
+        search_node (double _alpha, double _beta, double _score): alpha(_alpha), beta(_beta), score(_score) {}
+
+        bool is_cut() const
+        {
+            return alpha.load() - beta.load() >= -EPSILON;
+        }
+    };
+
+    // the counters of one thread, written by that thread only, so that they need no
+    // read-modify-write; padded so that the threads do not share a cache line
+    class thread_stats
+    {
+    public:
+        std::atomic<size_t> nodes, table_probes, table_hits, table_cutoffs, cycles;
+        std::atomic<size_t> cutoffs_by_move[state::max_moves()];
+        char padding[64];
+
+        thread_stats()
+        {
+            clear();
+        }
+
+        static void add (std::atomic<size_t> &counter, size_t count = 1)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        }
+
+        void clear()
+        {
+            nodes.store(0, std::memory_order_relaxed);
+            table_probes.store(0, std::memory_order_relaxed);
+            table_hits.store(0, std::memory_order_relaxed);
+            table_cutoffs.store(0, std::memory_order_relaxed);
+            cycles.store(0, std::memory_order_relaxed);
+            for (std::atomic<size_t> &counter : cutoffs_by_move)
+                counter.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    // what one thread has learnt about ordering moves, used and written by that thread only:
+    // the two latest moves that cut off at every ply, and how much every move has cut off
+    // for either side, deeper cutoffs counting more
+    class move_history
+    {
+    public:
+        int killers[MAX_DEPTH][2];
+        unsigned history[2][state::max_move_codes()];
+        char padding[64];
+
+        move_history()
+        {
+            for (auto &ply : killers)
+                ply[0] = ply[1] = -1;
+            for (auto &side : history)
+                for (unsigned &count : side)
+                    count = 0;
+        }
+
+        // a new evaluation keeps half of what the earlier ones learnt, and none of their killers
+        void age()
+        {
+            for (auto &ply : killers)
+                ply[0] = ply[1] = -1;
+            for (auto &side : history)
+                for (unsigned &count : side)
+                    count /= 2;
+        }
+    };
+
+    GameGraph graph;
+    Solver solver;
+    bool use_solver;
+    Book book;
+    bool use_symmetry;
+    Thread::LockFreeMap<evaluating_node_data> table; // keyed by canonical states, see canonical
+    unsigned generation = 0; // bumped on every iteration, so moves searched by earlier ones are searched again
     Thread::ThreadPool Pool;
-    int branch_id_counter;
-    Thread::Atomic<size_t> state_evaluated;
+    std::atomic<bool> stopped;
+    std::atomic<size_t> state_evaluated; // only counted against a budget of states, see search_limits
+
+    // one slot per pool thread, and the last one for the thread that calls evaluate_next_move
+    std::unique_ptr<thread_stats[]> stats;
+    std::unique_ptr<move_history[]> histories; // indexed like stats
+    mutable std::mutex depth_mutex; // guards depth_seconds
+    std::vector<double> depth_seconds;
+    std::chrono::steady_clock::time_point started;
+    double idle_at_start = 0;
+
+    // set before an iteration starts, only read by the search
+    search_limits limits;
+    std::chrono::steady_clock::time_point deadline;
+    bool limited = false; // the limits apply once an iteration has completed
+
+    Thread::TaskGroup pondering;
 
     void calculate_original_score (state current, evaluating_node_data &node);
-    void after_search (std::tuple<move_data, state, int> st,
-                       evaluating_node_data &node,
-                       int depth,
-                       bool maximizing,
-                       double &alpha,
-                       double &beta);
+    void after_search (std::pair<move_code, state> move, search_node &node, bool maximizing);
+    bool is_solved (int hash_state) const;
+    bool out_of_budget (size_t evaluated) const;
+    thread_stats& local_stats();
+    state canonical (const state &current, typename state::symmetry *applied = nullptr) const;
+    move_history& local_history();
+    void order_moves (const state &current, std::vector<std::pair<move_code, state> > &moves, int table_move, size_t ply);
+    void record_cutoff (bool white, move_code code, int depth, size_t ply);
+    void deepen (state game_state, const search_limits &_limits, bool timed = false);
     void search(state current,
-                std::vector<int> branch = { 0 },
-                int depth = EVALUATION_DEPTH,
+                search_path &path,
+                int depth,
                 double alpha = -ABS_SCORE,
                 double beta = ABS_SCORE,
                 bool maximizing = true);
 
 public:
+    // without use_symmetry, mirrored states are searched and stored apart; only to measure what the symmetries save
+    BasicEvaluator (bool _use_solver = true, size_t num_of_threads = 0, bool _use_symmetry = true);
+    ~BasicEvaluator();
     node_data get_node_data(int hash_state) const;
     node_data get_node_data(state game_state) const;
-    void evaluate_next_move(int hash_state);
-    void evaluate_next_move(state game_state);
+    void evaluate_next_move(int hash_state, const search_limits &_limits = search_limits());
+    void evaluate_next_move(state game_state, const search_limits &_limits = search_limits());
     size_t get_last_number_of_evaluated_states() const;
+    size_t get_number_of_stored_states() const;
+
+    // may be called from another thread while an evaluation runs
+    search_stats get_search_stats() const;
+
+    // maps a book written by tools/write_book; the states it has are never searched.
+    // false if there is no such file, throws if it is not a book for these rules
+    bool load_book (const std::string &path);
+
+    // called from another thread, ends the running evaluation as if its budget ran out
+    void stop();
+
+    // searches the replies to game_state in the background, while the opponent
+    // thinks; the results stay in the table for the evaluation of the real move
+    void ponder (state game_state);
+    void stop_pondering();
 };
 
+typedef BasicEvaluator<standard_rules> Evaluator;
+
 #endif // EVALUATOR_H
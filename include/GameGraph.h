@@ -0,0 +1,64 @@
+#ifndef GAMEGRAPH_H
+#define GAMEGRAPH_H
+
+#include "Move.hpp"
+#include "Rules.hpp"
+#include "State.hpp"
+#include <vector>
+
+// The whole game graph, built once and read-only afterwards, so it can be
+// shared between threads without locking. Successors and predecessors of
+// every state are stored as compressed sparse rows indexed by state hash.
+template< typename Rules >
+class BasicGameGraph
+{
+public:
+    typedef basic_state<Rules> state;
+
+    class edge
+    {
+    public:
+        int hash; // the state the move leads to, or comes from for predecessors
+        move_code code;
+    };
+
+    class edge_range
+    {
+    private:
+        const edge *_begin, *_end;
+
+    public:
+        edge_range (const edge *__begin, const edge *__end): _begin(__begin), _end(__end) {}
+
+        const edge* begin() const { return _begin; }
+        const edge* end() const { return _end; }
+        size_t size() const { return _end - _begin; }
+        bool empty() const { return _begin == _end; }
+        const edge& operator[] (size_t i) const { return _begin[i]; }
+    };
+
+private:
+    std::vector<bool> valid;
+    std::vector<int> successor_offsets, predecessor_offsets;
+    std::vector<edge> successor_edges, predecessor_edges;
+
+    static void generate_edges (const state &current, std::vector<edge> &edges);
+
+public:
+    BasicGameGraph();
+
+    // non-copyable
+    BasicGameGraph (const BasicGameGraph&) = delete;
+    BasicGameGraph& operator= (const BasicGameGraph&) = delete;
+
+    int size() const;
+    bool has_state (int hash_state) const;
+    size_t number_of_states() const;
+    size_t number_of_edges() const;
+    edge_range successors (int hash_state) const;
+    edge_range predecessors (int hash_state) const;
+};
+
+typedef BasicGameGraph<standard_rules> GameGraph;
+
+#endif // GAMEGRAPH_H
@@ -0,0 +1,194 @@
+#ifndef GENERICRULES_H
+#define GENERICRULES_H
+
+#include "Move.hpp"
+#include "State.hpp"
+#include <istream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Generic
+{
+    // Rule parameters as they come from a config file or a request; nothing
+    // is checked until they are turned into Rules. Players are indexed in
+    // turn order, white first, and hands from the left.
+    class rule_parameters
+    {
+    public:
+        static const int MAX_PLAYERS = 4;
+        static const int MAX_HANDS = 4; // per player
+
+        short players = 2;
+        short hands = 2; // per player
+        short hand_max[MAX_PLAYERS][MAX_HANDS];
+        short split_max[MAX_PLAYERS]; // negative value for unlimited splits
+
+        bool splits_as_moves = true;
+        bool allow_sacrifical_splits = true;
+        bool allow_regenerative_splits = true;
+        bool meta_variant = false;
+
+        rule_parameters();
+
+        // the parameters of a compile-time variant from Rules.hpp
+        template< typename Policy >
+        static rule_parameters of()
+        {
+            rule_parameters ret;
+
+            ret.hand_max[0][0] = Policy::white_left_hand_max;
+            ret.hand_max[0][1] = Policy::white_right_hand_max;
+            ret.hand_max[1][0] = Policy::black_left_hand_max;
+            ret.hand_max[1][1] = Policy::black_right_hand_max;
+            ret.split_max[0] = Policy::white_split_max;
+            ret.split_max[1] = Policy::black_split_max;
+            ret.splits_as_moves = Policy::splits_as_moves;
+            ret.allow_sacrifical_splits = Policy::allow_sacrifical_splits;
+            ret.allow_regenerative_splits = Policy::allow_regenerative_splits;
+            ret.meta_variant = Policy::meta_variant;
+
+            return ret;
+        }
+
+        // "name = value" lines, named as the members of the policies in Rules.hpp,
+        // or players, hands, and hand_max or split_max for all hands or players at
+        // once; parameters that are not given keep their standard values, # starts a comment
+        static rule_parameters parse (std::istream &in);
+        static rule_parameters parse (const std::string &text);
+    };
+
+    // wider than the packed_state of basic_state, which the larger variants overflow
+    typedef uint64_t packed_state;
+
+    // A variant checked once and compiled into lookup tables, so that the
+    // generic state plays it without testing any rule in its move generator.
+    class Rules
+    {
+    public:
+        static const short MAX_HAND = 64; // largest hand maximum
+
+        // a legal split between a pair of hands, a and b with a < b
+        class split
+        {
+        public:
+            unsigned char a, b;  // the hands after the split
+            signed char change; // fingers added to a and taken from b, or the other way if negative
+        };
+
+    private:
+        rule_parameters parameters;
+
+        // sums[player][hand][value * MAX_HAND + fingers] is the hand after fingers are added to value
+        std::vector<unsigned char> sums[rule_parameters::MAX_PLAYERS][rule_parameters::MAX_HANDS];
+
+        // the legal splits of every pair of values, as compressed sparse rows indexed by
+        // a * hand_max(player, b) + b, one table per player and pair of hands; splits
+        // only ever involve two hands, so the tables grow with the pairs, not the positions
+        std::vector<std::pair<int, int> > pairs;
+        std::vector<int> split_offsets[rule_parameters::MAX_PLAYERS];
+        std::vector<int> pair_offsets[rule_parameters::MAX_PLAYERS]; // where the rows of every pair start
+        std::vector<split> splits;
+
+        // the state is packed as a mixed-radix number of 64 bits, turn first,
+        // then every hand, then the limited split counters
+        packed_state turn_stride, hand_strides[rule_parameters::MAX_PLAYERS][rule_parameters::MAX_HANDS],
+                     split_strides[rule_parameters::MAX_PLAYERS];
+        packed_state count;
+        int moves;
+
+        void build_strides();
+        void build_sums();
+        void build_splits();
+
+    public:
+        // throws if the parameters make no playable variant, or one whose states do not fit in 64 bits
+        explicit Rules (const rule_parameters &_parameters = rule_parameters());
+
+        const rule_parameters& get_parameters() const
+        {
+            return parameters;
+        }
+
+        int players() const
+        {
+            return parameters.players;
+        }
+
+        int hands() const
+        {
+            return parameters.hands;
+        }
+
+        short hand_max (int player, int hand) const
+        {
+            return parameters.hand_max[player][hand];
+        }
+
+        short split_max (int player) const
+        {
+            return parameters.split_max[player];
+        }
+
+        bool splits_as_moves() const
+        {
+            return parameters.splits_as_moves;
+        }
+
+        unsigned char add (int player, int hand, int value, int fingers) const
+        {
+            return sums[player][hand][value * MAX_HAND + fingers];
+        }
+
+        // pairs of hands (a, b) with a < b, in the order their splits are generated
+        const std::vector<std::pair<int, int> >& hand_pairs() const
+        {
+            return pairs;
+        }
+
+        const split* splits_begin (int player, int pair, int a, int b) const
+        {
+            return splits.data() + split_offsets[player][pair_offsets[player][pair] + a * hand_max(player, pairs[pair].second) + b];
+        }
+
+        const split* splits_end (int player, int pair, int a, int b) const
+        {
+            return splits.data() + split_offsets[player][pair_offsets[player][pair] + a * hand_max(player, pairs[pair].second) + b + 1];
+        }
+
+        packed_state stride_of_turn() const
+        {
+            return turn_stride;
+        }
+
+        packed_state stride_of_hand (int player, int hand) const
+        {
+            return hand_strides[player][hand];
+        }
+
+        packed_state stride_of_splits (int player) const
+        {
+            return split_strides[player];
+        }
+
+        // all hashes of valid games lie in [0, hash_count())
+        packed_state hash_count() const
+        {
+            return count;
+        }
+
+        // upper bound of the number of legal moves in any state
+        int max_moves() const
+        {
+            return moves;
+        }
+
+        // the rule checks of a split between hands a and b of a player, as
+        // state::try_make_split_move does them for the left and right hand;
+        // the hands after a legal split are written to new_a and new_b
+        move_status check_split (int player, int a, int b, int value_a, int value_b, int change_a, int change_b,
+                                 short &new_a, short &new_b) const;
+    };
+}
+
+#endif // GENERICRULES_H
@@ -0,0 +1,413 @@
+#ifndef GENERICSTATE_HPP_INCLUDED
+#define GENERICSTATE_HPP_INCLUDED
+
+#include "GenericRules.h"
+#include "Move.hpp"
+#include "State.hpp"
+#include <stdexcept>
+
+namespace Generic
+{
+    // A move of any number of hands and players. move_data only knows the left
+    // and right hand of two players, so moves convert to it in those variants only.
+    class move
+    {
+    public:
+        bool is_split = false;
+        unsigned char hand = 0;          // the hand that strikes, or that a split takes from
+        unsigned char target_player = 0; // the player struck; splits stay with the mover
+        unsigned char target_hand = 0;   // the hand struck, or that a split adds to
+        unsigned char amount = 0;        // fingers moved by a split
+
+        static move strike (int hand, int target_player, int target_hand)
+        {
+            move ret;
+            ret.hand = hand;
+            ret.target_player = target_player;
+            ret.target_hand = target_hand;
+            return ret;
+        }
+
+        static move split (int player, int from, int to, int amount)
+        {
+            move ret = strike(from, player, to);
+            ret.is_split = true;
+            ret.amount = amount;
+            return ret;
+        }
+
+        static move from_move_data (const move_data &data, int mover)
+        {
+            if (data.is_split)
+                return data.fparam < 0 ? split(mover, 0, 1, -data.fparam) : split(mover, 1, 0, data.fparam);
+
+            return strike(toupper(data.fparam) == 'R', !mover, toupper(data.sparam) == 'R');
+        }
+
+        move_data to_move_data() const
+        {
+            if (is_split)
+                return hand ? move_data(amount, -amount, true) : move_data(-amount, amount, true);
+
+            return move_data(hand ? 'R' : 'L', target_hand ? 'R' : 'L');
+        }
+    };
+
+    // A position under rules given at runtime. It plays like basic_state, and
+    // two-player variants with two hands pack to the same hashes, but every
+    // rule is read from the tables of its Rules, which have to outlive it.
+    class state
+    {
+    private:
+        move_status check_can_move() const
+        {
+            if (!is_valid())
+                return MOVE_INVALID_STATE;
+            if (number_of_players_alive() == 1)
+                return MOVE_GAME_OVER;
+            return MOVE_LEGAL;
+        }
+
+        // the turn goes round, past the players that are out, unless the game is over
+        void pass_turn()
+        {
+            // the other player of two is the only one left to move, or the winner
+            if (rules->players() == 2)
+            {
+                turn ^= 1;
+                return;
+            }
+
+            const bool over = is_over();
+            do
+                turn = (turn + 1) % rules->players();
+            while (!over && !is_alive(turn));
+        }
+
+        void after_split (int player)
+        {
+            if (rules->split_max(player) > 0)
+                --splits[player];
+            if (rules->splits_as_moves())
+                pass_turn();
+        }
+
+    public:
+        const Rules *rules;
+        unsigned char hands[rule_parameters::MAX_PLAYERS][rule_parameters::MAX_HANDS];
+        short splits[rule_parameters::MAX_PLAYERS]; // the splits left, if they are limited
+        unsigned char turn;                          // the player to move
+
+        explicit state (const Rules &_rules): rules(&_rules), turn(0)
+        {
+            for (int player = 0; player < rule_parameters::MAX_PLAYERS; ++player)
+            {
+                for (int hand = 0; hand < rule_parameters::MAX_HANDS; ++hand)
+                    hands[player][hand] = player < rules->players() && hand < rules->hands();
+                splits[player] = rules->split_max(player);
+            }
+        }
+
+        bool is_alive (int player) const
+        {
+            for (int hand = 0; hand < rules->hands(); ++hand)
+                if (hands[player][hand])
+                    return true;
+            return false;
+        }
+
+        int number_of_players_alive() const
+        {
+            int ret = 0;
+            for (int player = 0; player < rules->players(); ++player)
+                ret += is_alive(player);
+            return ret;
+        }
+
+        bool is_valid() const
+        {
+            if (turn >= rules->players())
+                return false;
+
+            for (int player = 0; player < rules->players(); ++player)
+            {
+                for (int hand = 0; hand < rules->hands(); ++hand)
+                    if (hands[player][hand] >= rules->hand_max(player, hand))
+                        return false;
+
+                if (rules->split_max(player) > 0 && splits[player] < 0)
+                    return false;
+            }
+
+            // a player who is out never gets the turn while the game goes on
+            const int alive = number_of_players_alive();
+            return alive == 1 || (alive > 1 && is_alive(turn));
+        }
+
+        bool is_over() const
+        {
+            return is_valid() && number_of_players_alive() == 1;
+        }
+
+        // the index of the last player standing
+        int get_winner() const
+        {
+            if (is_valid() && is_over())
+                for (int player = 0; player < rules->players(); ++player)
+                    if (is_alive(player))
+                        return player;
+
+            throw std::runtime_error("Invalid state: Cannot determine winners of ongoing or invalid games");
+        }
+
+        // applies a move if it is legal, otherwise leaves the state untouched
+        move_status try_make_move (const move &m)
+        {
+            const move_status status = check_can_move();
+            if (status != MOVE_LEGAL)
+                return status;
+
+            const int me = turn, hand_count = rules->hands();
+
+            if (m.hand >= hand_count || m.target_hand >= hand_count || m.target_player >= rules->players())
+                return MOVE_BAD_SIDES;
+
+            if (m.is_split)
+            {
+                if (m.target_player != me || m.hand == m.target_hand)
+                    return MOVE_BAD_SPLIT;
+
+                if (rules->split_max(me) > 0 && !splits[me])
+                    return MOVE_NO_SPLITS_LEFT;
+
+                // the rules are checked for the pair of hands in order
+                const bool forward = m.hand < m.target_hand;
+                const int a = forward ? m.hand : m.target_hand, b = forward ? m.target_hand : m.hand;
+                const int change = forward ? -m.amount : m.amount;
+
+                short new_a, new_b;
+                const move_status split_status = rules->check_split(me, a, b, hands[me][a], hands[me][b], change, -change, new_a, new_b);
+                if (split_status != MOVE_LEGAL)
+                    return split_status;
+
+                hands[me][a] = new_a;
+                hands[me][b] = new_b;
+                after_split(me);
+
+                return MOVE_LEGAL;
+            }
+
+            if (m.target_player == me)
+                return MOVE_BAD_SIDES;
+            if (!hands[me][m.hand])
+                return MOVE_ELIMINATED_HAND;
+            if (!hands[m.target_player][m.target_hand])
+                return MOVE_ELIMINATED_TARGET;
+
+            hands[m.target_player][m.target_hand] = rules->add(m.target_player, m.target_hand,
+                                                               hands[m.target_player][m.target_hand], hands[me][m.hand]);
+            pass_turn();
+
+            return MOVE_LEGAL;
+        }
+
+        // the moves of two-player variants with a left and a right hand
+        move_status try_make_move (const move_data &data)
+        {
+            return try_make_move(move::from_move_data(data, turn));
+        }
+
+        // the moves of two players with two hands each, the variants of Rules.hpp,
+        // with the loops the compiler can unroll and a single pair of hands
+        int generate_duel_moves (move *moves, state *targets) const
+        {
+            int count = 0;
+            const int me = turn, op = !me;
+
+            // is_valid and is_over for two players
+            if (turn > 1)
+                return count;
+            for (int player = 0; player < 2; ++player)
+            {
+                if (hands[player][0] >= rules->hand_max(player, 0) || hands[player][1] >= rules->hand_max(player, 1) ||
+                    (rules->split_max(player) > 0 && splits[player] < 0))
+                    return count;
+                if (!hands[player][0] && !hands[player][1])
+                    return count;
+            }
+
+            for (int hand = 0; hand < 2; ++hand)
+                for (int op_hand = 0; op_hand < 2; ++op_hand)
+                    if (hands[me][hand] && hands[op][op_hand])
+                    {
+                        if (targets)
+                        {
+                            state &target = targets[count];
+                            target = *this;
+                            target.hands[op][op_hand] = rules->add(op, op_hand, hands[op][op_hand], hands[me][hand]);
+                            target.turn = op;
+                        }
+                        moves[count++] = move::strike(hand, op, op_hand);
+                    }
+
+            if (rules->split_max(me) > 0 && !splits[me])
+                return count;
+
+            const Rules::split *last = rules->splits_end(me, 0, hands[me][0], hands[me][1]);
+            for (const Rules::split *s = rules->splits_begin(me, 0, hands[me][0], hands[me][1]); s != last; ++s)
+            {
+                if (targets)
+                {
+                    state &target = targets[count];
+                    target = *this;
+                    target.hands[me][0] = s->a;
+                    target.hands[me][1] = s->b;
+                    target.after_split(me);
+                }
+                moves[count++] = s->change < 0 ? move::split(me, 0, 1, -s->change) : move::split(me, 1, 0, s->change);
+            }
+
+            return count;
+        }
+
+        // writes the legal moves, and the states they lead to if asked, into buffers
+        // of rules->max_moves() entries; returns the number of moves written
+        int generate_moves (move *moves, state *targets = nullptr) const
+        {
+            if (rules->players() == 2 && rules->hands() == 2)
+                return generate_duel_moves(moves, targets);
+
+            int count = 0;
+
+            if (check_can_move() != MOVE_LEGAL)
+                return count;
+
+            const int me = turn, players = rules->players(), hand_count = rules->hands();
+
+            // strikes, at the players in turn order after the mover
+            for (int hand = 0; hand < hand_count; ++hand)
+            {
+                if (!hands[me][hand])
+                    continue;
+
+                for (int i = 1; i < players; ++i)
+                {
+                    const int op = (me + i) % players;
+
+                    for (int op_hand = 0; op_hand < hand_count; ++op_hand)
+                    {
+                        if (!hands[op][op_hand])
+                            continue;
+
+                        if (targets)
+                        {
+                            state &target = targets[count];
+                            target = *this;
+                            target.hands[op][op_hand] = rules->add(op, op_hand, hands[op][op_hand], hands[me][hand]);
+                            target.pass_turn();
+                        }
+                        moves[count++] = move::strike(hand, op, op_hand);
+                    }
+                }
+            }
+
+            // splits, straight from the tables of every pair of hands
+            if (rules->split_max(me) > 0 && !splits[me])
+                return count;
+
+            const std::vector<std::pair<int, int> > &pairs = rules->hand_pairs();
+            for (int pair = 0; pair < (int)pairs.size(); ++pair)
+            {
+                const int a = pairs[pair].first, b = pairs[pair].second;
+
+                const Rules::split *last = rules->splits_end(me, pair, hands[me][a], hands[me][b]);
+                for (const Rules::split *s = rules->splits_begin(me, pair, hands[me][a], hands[me][b]); s != last; ++s)
+                {
+                    if (targets)
+                    {
+                        state &target = targets[count];
+                        target = *this;
+                        target.hands[me][a] = s->a;
+                        target.hands[me][b] = s->b;
+                        target.after_split(me);
+                    }
+                    moves[count++] = s->change < 0 ? move::split(me, a, b, -s->change) : move::split(me, b, a, s->change);
+                }
+            }
+
+            return count;
+        }
+
+        // a mixed-radix number with the strides of the rules; the turn is counted
+        // down from the last player, so that white to move packs like basic_state
+        packed_state pack() const
+        {
+            packed_state result = (rules->players() - 1 - turn) * rules->stride_of_turn();
+
+            if (rules->players() == 2 && rules->hands() == 2)
+            {
+                result += hands[0][0] * rules->stride_of_hand(0, 0) + hands[0][1] * rules->stride_of_hand(0, 1) +
+                          hands[1][0] * rules->stride_of_hand(1, 0) + hands[1][1] * rules->stride_of_hand(1, 1);
+
+                if (rules->split_max(0) > 0)
+                    result += splits[0] * rules->stride_of_splits(0);
+                if (rules->split_max(1) > 0)
+                    result += splits[1] * rules->stride_of_splits(1);
+
+                return result;
+            }
+
+            for (int player = 0; player < rules->players(); ++player)
+            {
+                for (int hand = 0; hand < rules->hands(); ++hand)
+                    result += hands[player][hand] * rules->stride_of_hand(player, hand);
+
+                if (rules->split_max(player) > 0)
+                    result += splits[player] * rules->stride_of_splits(player);
+            }
+
+            return result;
+        }
+
+        static state unpack (const Rules &rules, packed_state packed)
+        {
+            state result(rules);
+
+            result.turn = rules.players() - 1 - packed / rules.stride_of_turn() % rules.players();
+
+            for (int player = 0; player < rules.players(); ++player)
+            {
+                for (int hand = 0; hand < rules.hands(); ++hand)
+                    result.hands[player][hand] = packed / rules.stride_of_hand(player, hand) % rules.hand_max(player, hand);
+
+                if (rules.split_max(player) > 0)
+                    result.splits[player] = packed / rules.stride_of_splits(player) % (rules.split_max(player) + 1);
+            }
+
+            return result;
+        }
+
+        packed_state get_hash() const
+        {
+            if (!is_valid())
+                throw std::runtime_error("Invalid state: Cannot get hash of invalid games");
+
+            return pack();
+        }
+
+        static state parse_hash (const Rules &rules, packed_state hashed)
+        {
+            if (hashed >= rules.hash_count())
+                throw std::runtime_error("Parse error: Invalid game hash");
+
+            const state result = unpack(rules, hashed);
+
+            if (!result.is_valid())
+                throw std::runtime_error("Parse error: Invalid game hash");
+
+            return result;
+        }
+    };
+}
+
+#endif // GENERICSTATE_HPP_INCLUDED
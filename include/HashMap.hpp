@@ -1,8 +1,9 @@
 #ifndef HASHMAP_HPP_INCLUDED
 #define HASHMAP_HPP_INCLUDED
 
-#include "Thread.hpp"
+#include "LightAtomic.hpp"
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -13,23 +14,29 @@ namespace Thread
     class HashMap
     {
     private:
-        std::unordered_map<K, Atomic<V>* > table;
+        std::unordered_map<K, LightAtomic<V>* > table;
         std::mutex mutex;
+        lock_name name;
 
     public:
-        Atomic<V>& operator[] (const K& key)
+        HashMap() {}
+
+        // counts its locks under its own name in the lock profile
+        explicit HashMap (lock_name _name): name(_name) {}
+
+        LightAtomic<V>& operator[] (const K& key)
         {
             auto it = table.find(key);
             if (it == table.end())
             {
-                std::unique_lock<std::mutex> lock(mutex);
-                table[key] = new Atomic<V>();
+                THREAD_LOCK_OF(lock, mutex, name, "HashMap::insert");
+                table[key] = new LightAtomic<V>();
                 return *table[key];
             }
             return *it->second;
         }
 
-        Atomic<V>& operator[] (const K& key) const
+        LightAtomic<V>& operator[] (const K& key) const
         {
             auto it = table.find(key);
             if (it == table.end())
@@ -45,7 +52,7 @@ namespace Thread
 
         void clear()
         {
-            std::unique_lock<std::mutex> lock(mutex);
+            THREAD_LOCK_OF(lock, mutex, name, "HashMap::clear");
             for (auto it : table)
                 delete table[it.first];
             table.clear();
@@ -53,7 +60,7 @@ namespace Thread
 
         std::vector<K> keys()
         {
-            std::unique_lock<std::mutex> lock(mutex);
+            THREAD_LOCK_OF(lock, mutex, name, "HashMap::keys");
             std::vector<K> ret;
 
             for (auto it = table.begin(); it != table.end(); ++it)
@@ -64,7 +71,7 @@ namespace Thread
 
         std::vector<std::pair<K, V> > entities()
         {
-            std::unique_lock<std::mutex> lock(mutex);
+            THREAD_LOCK_OF(lock, mutex, name, "HashMap::entities");
             std::vector<std::pair<K, V> > ret;
 
             for (auto it = table.begin(); it != table.end(); ++it)
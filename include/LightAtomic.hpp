@@ -0,0 +1,325 @@
+#ifndef LIGHTATOMIC_HPP_INCLUDED
+#define LIGHTATOMIC_HPP_INCLUDED
+
+#include "LockProfile.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Thread
+{
+    // busy waiting that gives the core away once it has gone on for a while
+    class Backoff
+    {
+    private:
+        int spins = 0;
+
+    public:
+        void pause()
+        {
+            if (++spins < 64)
+            {
+#if defined(__i386__) || defined(__x86_64__)
+                __builtin_ia32_pause();
+#endif
+            }
+            else
+                std::this_thread::yield();
+        }
+    };
+
+    // Waiting for any object without a condition variable in every one of
+    // them: a waiter parks on the bucket its address hashes to, and whoever
+    // changes the object wakes the bucket. Objects only call unpark_all when
+    // they know someone has parked, so the lot costs nothing until it is used.
+    class ParkingLot
+    {
+    private:
+        static const size_t BUCKETS = 64;
+
+        struct alignas(64) bucket
+        {
+            std::mutex mutex;
+            lock_condition cv;
+        };
+
+        static bucket& bucket_of (const void *address)
+        {
+            static bucket buckets[BUCKETS];
+            return buckets[((uintptr_t)address >> 6) % BUCKETS];
+        }
+
+    public:
+        // announce() runs under the bucket lock and tells the object a waiter
+        // is coming, then blocks until the bucket is woken, or spuriously;
+        // the caller checks its condition again either way
+        template< typename Announce >
+        static void park (const void *address, Announce announce)
+        {
+            bucket &b = bucket_of(address);
+
+            THREAD_LOCK(lock, b.mutex, "ParkingLot::park");
+            if (announce())
+                lock.wait(b.cv);
+        }
+
+        // wakes every waiter of the bucket, which may include waiters of other objects
+        static void unpark_all (const void *address)
+        {
+            bucket &b = bucket_of(address);
+
+            THREAD_LOCK(lock, b.mutex, "ParkingLot::unpark_all");
+            b.cv.notify_all();
+        }
+    };
+
+    // The drop-in replacement of Atomic: a one-byte spin lock instead of a
+    // mutex and a condition variable, and accessors that take any callable
+    // without wrapping it in a std::function. Waiters park in the ParkingLot.
+    // Meant for short critical sections, as in the tables.
+    template< typename T, typename Comparator = std::not_equal_to<T> >
+    class LightAtomic
+    {
+    private:
+        static const uint8_t LOCKED = 1, PARKED = 2;
+
+        mutable std::atomic<uint8_t> word;
+        Comparator comp; // ahead of the state, so that it shares the padding of the lock
+        T state;
+
+        void lock() const
+        {
+            Backoff backoff;
+            while (word.fetch_or(LOCKED, std::memory_order_acquire) & LOCKED)
+                do
+                    backoff.pause();
+                while (word.load(std::memory_order_relaxed) & LOCKED);
+        }
+
+        // only a change wakes the waiters, a read leaves them parked
+        void unlock (bool changed) const
+        {
+            if (!changed)
+                word.fetch_and(PARKED, std::memory_order_release);
+            else if (word.exchange(0, std::memory_order_release) & PARKED)
+                ParkingLot::unpark_all(this);
+        }
+
+    public:
+        LightAtomic (Comparator _comp = Comparator()): word(0), comp(_comp), state() {}
+        LightAtomic (const T& _state, Comparator _comp = Comparator()): word(0), comp(_comp), state(_state) {}
+        LightAtomic (T&& _state, Comparator _comp = Comparator()): word(0), comp(_comp), state(std::move(_state)) {}
+
+        // neither copyable nor movable, waiters park on the address
+        LightAtomic (const LightAtomic&) = delete;
+        LightAtomic& operator= (const LightAtomic&) = delete;
+
+        // blocks until comp(value, state) holds
+        void wait_until_cond (const T& state) const
+        {
+            while (true)
+            {
+                lock();
+                if (comp(this->state, state))
+                {
+                    unlock(false);
+                    return;
+                }
+
+                // the lock is handed over under the bucket lock, so the change cannot slip in before the waiter sleeps
+                ParkingLot::park(this, [this]() {
+                    word.store(PARKED, std::memory_order_release);
+                    return true;
+                });
+            }
+        }
+
+        void set (const T& state)
+        {
+            lock();
+            const bool changed = comp(this->state, state);
+            if (changed)
+                this->state = state;
+            unlock(changed);
+        }
+
+        void set (T&& state)
+        {
+            lock();
+            const bool changed = comp(this->state, state);
+            if (changed)
+                this->state = std::move(state);
+            unlock(changed);
+        }
+
+        T get() const
+        {
+            lock();
+            T ret = state;
+            unlock(false);
+            return ret;
+        }
+
+        template< typename Accessor >
+        void access (Accessor&& fn) const
+        {
+            lock();
+            try
+            {
+                fn(static_cast<const T&>(state));
+            }
+            catch (...)
+            {
+                unlock(false);
+                throw;
+            }
+            unlock(false);
+        }
+
+        template< typename Mutator >
+        void mutate (Mutator&& fn)
+        {
+            lock();
+            try
+            {
+                fn(state);
+            }
+            catch (...)
+            {
+                unlock(true);
+                throw;
+            }
+            unlock(true);
+        }
+    };
+
+    // For read-mostly values that are trivially copyable: a sequence lock
+    // like the slots of LockFreeMap, so readers copy the value out without
+    // writing to shared memory, and only writers take turns.
+    template< typename T, typename Comparator = std::not_equal_to<T> >
+    class SeqAtomic
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Values of a sequence lock must be trivially copyable");
+
+    private:
+        // the low bits of the sequence flag a writer and parked waiters, the rest counts the writes
+        static const uint32_t WRITING = 1, PARKED = 2, STEP = 4;
+        static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        mutable std::atomic<uint32_t> sequence;
+        Comparator comp;
+        std::atomic<uint64_t> words[WORDS];
+
+        void store (const T &value)
+        {
+            uint64_t copy[WORDS] = {};
+            memcpy(copy, &value, sizeof(T));
+            for (size_t i = 0; i < WORDS; ++i)
+                words[i].store(copy[i], std::memory_order_relaxed);
+        }
+
+        T load() const
+        {
+            uint64_t copy[WORDS];
+            for (size_t i = 0; i < WORDS; ++i)
+                copy[i] = words[i].load(std::memory_order_relaxed);
+
+            T value;
+            memcpy(&value, copy, sizeof(T));
+            return value;
+        }
+
+        template< typename Mutator >
+        void write (Mutator&& fn)
+        {
+            Backoff backoff;
+            uint32_t before;
+            while ((before = sequence.fetch_or(WRITING, std::memory_order_acquire)) & WRITING)
+                backoff.pause();
+
+            std::atomic_thread_fence(std::memory_order_release);
+
+            T value = load();
+            const bool changed = fn(value);
+            if (changed)
+                store(value);
+
+            const uint32_t after = (before & ~(WRITING | PARKED)) + (changed ? STEP : 0);
+            if (sequence.exchange(after, std::memory_order_release) & PARKED)
+                ParkingLot::unpark_all(this);
+        }
+
+    public:
+        SeqAtomic (Comparator _comp = Comparator()): sequence(0), comp(_comp) { store(T()); }
+        SeqAtomic (const T& _state, Comparator _comp = Comparator()): sequence(0), comp(_comp) { store(_state); }
+
+        // neither copyable nor movable, waiters park on the address
+        SeqAtomic (const SeqAtomic&) = delete;
+        SeqAtomic& operator= (const SeqAtomic&) = delete;
+
+        T get() const
+        {
+            Backoff backoff;
+
+            while (true)
+            {
+                const uint32_t before = sequence.load(std::memory_order_acquire);
+
+                if (!(before & WRITING))
+                {
+                    const T value = load();
+                    std::atomic_thread_fence(std::memory_order_acquire);
+
+                    // parking does not change the value
+                    if ((sequence.load(std::memory_order_relaxed) | PARKED) == (before | PARKED))
+                        return value;
+                }
+
+                backoff.pause();
+            }
+        }
+
+        // fn sees a consistent copy, not the value itself
+        template< typename Accessor >
+        void access (Accessor&& fn) const
+        {
+            const T value = get();
+            fn(value);
+        }
+
+        template< typename Mutator >
+        void mutate (Mutator&& fn)
+        {
+            write([&](T &value) { fn(value); return true; });
+        }
+
+        void set (const T& state)
+        {
+            write([&](T &value) {
+                if (!comp(value, state))
+                    return false;
+                value = state;
+                return true;
+            });
+        }
+
+        // blocks until comp(value, state) holds
+        void wait_until_cond (const T& state) const
+        {
+            while (!comp(get(), state))
+                ParkingLot::park(this, [&]() {
+                    // a write that ends after this sees the flag, one that ended before is seen by the check
+                    sequence.fetch_or(PARKED, std::memory_order_acq_rel);
+                    return !comp(get(), state);
+                });
+        }
+    };
+}
+
+#endif // LIGHTATOMIC_HPP_INCLUDED
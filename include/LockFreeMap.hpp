@@ -0,0 +1,270 @@
+#ifndef LOCKFREEMAP_HPP_INCLUDED
+#define LOCKFREEMAP_HPP_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Thread
+{
+    // An open-addressing map with a fixed capacity. Threads claim slots for
+    // new keys with a compare-and-swap and never remove them. Values are
+    // guarded by a sequence lock: readers copy them out without locking and
+    // retry if a writer got in between, writers take turns on the sequence.
+    // A slot starts with the turn taken, for the thread that claims it, so
+    // nobody sees a key before its first value.
+    // The value words are atomics themselves, so no access is a data race.
+    template< typename V >
+    class LockFreeMap
+    {
+        static_assert(std::is_trivially_copyable<V>::value, "Values of a lock-free map must be trivially copyable");
+
+    private:
+        static const uint64_t EMPTY = 0;     // keys are stored off by one
+        static const uint32_t UNWRITTEN = 1; // the sequence of a slot until its first value is in
+        static const size_t WORDS = (sizeof(V) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        struct alignas(64) slot
+        {
+            std::atomic<uint64_t> key;
+            std::atomic<uint32_t> sequence;
+            std::atomic<uint64_t> words[WORDS];
+        };
+
+        size_t _capacity, mask;
+        char *buffer;
+        slot *slots;
+        std::atomic<size_t> _size;
+        uint64_t initial[WORDS];
+
+        static uint64_t mix (uint64_t key)
+        {
+            // splitmix64 finalizer, so that neighbouring states spread over the table
+            key ^= key >> 30;
+            key *= 0xbf58476d1ce4e5b9ULL;
+            key ^= key >> 27;
+            key *= 0x94d049bb133111ebULL;
+            key ^= key >> 31;
+            return key;
+        }
+
+        void reset (slot &s)
+        {
+            s.key.store(EMPTY, std::memory_order_relaxed);
+            s.sequence.store(UNWRITTEN, std::memory_order_relaxed);
+            for (size_t i = 0; i < WORDS; ++i)
+                s.words[i].store(initial[i], std::memory_order_relaxed);
+        }
+
+        slot* find_slot (uint64_t key) const
+        {
+            const uint64_t stored = key + 1;
+
+            for (size_t i = mix(key) & mask, probes = 0; probes < _capacity; i = (i + 1) & mask, ++probes)
+            {
+                const uint64_t current = slots[i].key.load(std::memory_order_acquire);
+                if (current == stored)
+                    return slots + i;
+                if (current == EMPTY)
+                    return nullptr;
+            }
+
+            return nullptr;
+        }
+
+        // claimed is set if the calling thread took the slot, and with it the first turn to write
+        slot* claim_slot (uint64_t key, bool &claimed)
+        {
+            const uint64_t stored = key + 1;
+
+            for (size_t i = mix(key) & mask, probes = 0; probes < _capacity; i = (i + 1) & mask, ++probes)
+            {
+                uint64_t current = slots[i].key.load(std::memory_order_acquire);
+
+                if (current == EMPTY &&
+                    slots[i].key.compare_exchange_strong(current, stored, std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    _size.fetch_add(1, std::memory_order_relaxed);
+                    claimed = true;
+                    return slots + i;
+                }
+
+                // either found, or another thread has just claimed the slot for the same key
+                if (current == stored)
+                {
+                    claimed = false;
+                    return slots + i;
+                }
+            }
+
+            throw std::runtime_error("Lock-free map is full");
+        }
+
+        static V read (const slot &s)
+        {
+            uint64_t copy[WORDS];
+
+            while (true)
+            {
+                const uint32_t before = s.sequence.load(std::memory_order_acquire);
+
+                if (!(before & 1))
+                {
+                    for (size_t i = 0; i < WORDS; ++i)
+                        copy[i] = s.words[i].load(std::memory_order_relaxed);
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+
+                    if (s.sequence.load(std::memory_order_relaxed) == before)
+                        break;
+                }
+            }
+
+            V value;
+            memcpy(&value, copy, sizeof(V));
+            return value;
+        }
+
+        template< typename Mutator >
+        static void write (slot &s, bool claimed, Mutator&& fn)
+        {
+            // take the writer's turn by making the sequence odd, unless the slot was just claimed with it
+            uint32_t before = UNWRITTEN - 1;
+            if (!claimed)
+            {
+                before = s.sequence.load(std::memory_order_relaxed);
+                while ((before & 1) ||
+                       !s.sequence.compare_exchange_weak(before, before + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    before = s.sequence.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+
+            uint64_t copy[WORDS];
+            for (size_t i = 0; i < WORDS; ++i)
+                copy[i] = s.words[i].load(std::memory_order_relaxed);
+
+            V value;
+            memcpy(&value, copy, sizeof(V));
+            fn(value);
+            memcpy(copy, &value, sizeof(V));
+
+            for (size_t i = 0; i < WORDS; ++i)
+                s.words[i].store(copy[i], std::memory_order_relaxed);
+
+            s.sequence.store(before + 2, std::memory_order_release);
+        }
+
+    public:
+        // the capacity is rounded up to a power of two; keep it well above the number of keys
+        LockFreeMap (size_t capacity, const V &initial_value = V()): _size(0)
+        {
+            for (_capacity = 1; _capacity < capacity; _capacity <<= 1);
+            mask = _capacity - 1;
+
+            memset(initial, 0, sizeof(initial));
+            memcpy(initial, &initial_value, sizeof(V));
+
+            // operator new only guarantees alignof(std::max_align_t), so align by hand
+            size_t space = sizeof(slot) * _capacity + alignof(slot);
+            buffer = new char[space];
+
+            void *ptr = buffer;
+            slots = static_cast<slot*>(std::align(alignof(slot), sizeof(slot) * _capacity, ptr, space));
+
+            for (size_t i = 0; i < _capacity; ++i)
+                reset(*new (slots + i) slot());
+        }
+
+        ~LockFreeMap()
+        {
+            for (size_t i = 0; i < _capacity; ++i)
+                slots[i].~slot();
+            delete[] buffer;
+        }
+
+        // non-copyable
+        LockFreeMap (const LockFreeMap&) = delete;
+        LockFreeMap& operator= (const LockFreeMap&) = delete;
+
+        bool find (uint64_t key, V &value) const
+        {
+            const slot *s = find_slot(key);
+            if (!s)
+                return false;
+
+            value = read(*s);
+            return true;
+        }
+
+        V get (uint64_t key) const
+        {
+            const slot *s = find_slot(key);
+            if (!s)
+                throw std::runtime_error("Accessing unknown key in lock-free map is not allowed");
+
+            return read(*s);
+        }
+
+        bool has_key (uint64_t key) const
+        {
+            return find_slot(key) != nullptr;
+        }
+
+        void set (uint64_t key, const V &value)
+        {
+            bool claimed;
+            slot *s = claim_slot(key, claimed);
+            write(*s, claimed, [&](V &old) { old = value; });
+        }
+
+        // read-modify-write of one entry, inserting the initial value first if the key is new
+        template< typename Mutator >
+        void update (uint64_t key, Mutator&& fn)
+        {
+            bool claimed;
+            slot *s = claim_slot(key, claimed);
+            write(*s, claimed, std::forward<Mutator>(fn));
+        }
+
+        // not safe against concurrent access
+        void clear()
+        {
+            for (size_t i = 0; i < _capacity; ++i)
+                reset(slots[i]);
+            _size.store(0, std::memory_order_relaxed);
+        }
+
+        size_t size() const
+        {
+            return _size.load(std::memory_order_relaxed);
+        }
+
+        size_t capacity() const
+        {
+            return _capacity;
+        }
+
+        std::vector<std::pair<uint64_t, V> > entities() const
+        {
+            std::vector<std::pair<uint64_t, V> > ret;
+
+            for (size_t i = 0; i < _capacity; ++i)
+            {
+                const uint64_t key = slots[i].key.load(std::memory_order_acquire);
+                if (key != EMPTY)
+                    ret.push_back(std::make_pair(key - 1, read(slots[i])));
+            }
+
+            return ret;
+        }
+    };
+}
+
+#endif // LOCKFREEMAP_HPP_INCLUDED
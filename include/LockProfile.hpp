@@ -0,0 +1,304 @@
+#ifndef LOCKPROFILE_HPP_INCLUDED
+#define LOCKPROFILE_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// Lock contention profiling, compiled in with -DTHREAD_PROFILE_LOCKS only
+// ("make PROFILE_LOCKS=yes"). Every lock taken through THREAD_LOCK counts
+// towards the site it names: how often it was acquired, how often it had to
+// wait, a histogram of the waits and the time it was held. The report goes
+// to stderr at exit, or to the file named by CHOPSTICKS_LOCK_PROFILE.
+// Without the flag, THREAD_LOCK is a plain std::unique_lock.
+//
+// Locks wait on a lock_condition with their own wait(cv, pred), so that the
+// time asleep is not held, and waking up counts as taking the lock again.
+
+namespace Thread
+{
+    class lock_site
+    {
+    public:
+        static const int BUCKETS = 40; // waits of [2^i, 2^(i+1)) nanoseconds
+
+        const std::string name;
+        std::atomic<uint64_t> acquisitions, contended, wait_nanoseconds, hold_nanoseconds;
+        std::atomic<uint64_t> waits[BUCKETS];
+
+        explicit lock_site (const std::string &_name): name(_name), acquisitions(0), contended(0),
+                                                       wait_nanoseconds(0), hold_nanoseconds(0)
+        {
+            for (std::atomic<uint64_t> &bucket : waits)
+                bucket.store(0);
+        }
+
+        void add_wait (uint64_t nanoseconds)
+        {
+            int bucket = 0;
+            while (bucket + 1 < BUCKETS && nanoseconds >> (bucket + 1))
+                ++bucket;
+
+            contended.fetch_add(1, std::memory_order_relaxed);
+            wait_nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+            waits[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    // The sites by name. It is never destroyed, so that locks taken while the
+    // statics are torn down still have somewhere to count; the report is
+    // written by an atexit handler instead.
+    class lock_profile
+    {
+    private:
+        std::mutex mutex;
+        std::deque<lock_site> sites; // a deque never moves what it holds
+
+        lock_profile()
+        {
+            atexit([]() { instance().report(); });
+        }
+
+        static std::string format_nanoseconds (uint64_t nanoseconds)
+        {
+            static const char *units[] = { "ns", "us", "ms", "s" };
+
+            int unit = 0;
+            while (unit < 3 && nanoseconds >= 1000)
+            {
+                nanoseconds /= 1000;
+                ++unit;
+            }
+
+            return std::to_string(nanoseconds) + units[unit];
+        }
+
+    public:
+        static lock_profile& instance()
+        {
+            static lock_profile *profile = new lock_profile();
+            return *profile;
+        }
+
+        lock_site& site (const std::string &name)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (lock_site &s : sites)
+                if (s.name == name)
+                    return s;
+
+            sites.emplace_back(name);
+            return sites.back();
+        }
+
+        // the sites that waited the longest first
+        void report (std::ostream &out)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::vector<const lock_site*> sorted;
+            for (const lock_site &s : sites)
+                sorted.push_back(&s);
+            std::sort(sorted.begin(), sorted.end(), [](const lock_site *a, const lock_site *b) {
+                return a->wait_nanoseconds.load() > b->wait_nanoseconds.load();
+            });
+
+            out << "Lock profile: site  acquisitions  contended  wait ms  hold ms  waits by length" << std::endl
+                << std::fixed << std::setprecision(3);
+
+            for (const lock_site *s : sorted)
+            {
+                const uint64_t acquisitions = s->acquisitions.load(), contended = s->contended.load();
+                if (!acquisitions)
+                    continue; // every object of the call site counts under a name of its own
+
+                out << s->name << "  "
+                    << acquisitions << "  "
+                    << contended << " (" << (acquisitions ? 100.0 * contended / acquisitions : 0) << "%)  "
+                    << s->wait_nanoseconds.load() * 1e-6 << "  "
+                    << s->hold_nanoseconds.load() * 1e-6 << " ";
+
+                for (int bucket = 0; bucket < lock_site::BUCKETS; ++bucket)
+                    if (const uint64_t count = s->waits[bucket].load())
+                        out << " <" << format_nanoseconds(2ULL << bucket) << ":" << count;
+
+                out << std::endl;
+            }
+        }
+
+        void report()
+        {
+            const char *path = getenv("CHOPSTICKS_LOCK_PROFILE");
+            if (!path)
+            {
+                report(std::cerr);
+                return;
+            }
+
+            std::ofstream out(path);
+            report(out);
+        }
+    };
+
+    // The name the locks of one object count under, instead of the names of
+    // their call sites, which every object of a class shares; one site for all
+    // of them, so that the objects that wait the most stand out.
+    class lock_name
+    {
+#ifdef THREAD_PROFILE_LOCKS
+    private:
+        lock_site *site = nullptr;
+
+    public:
+        lock_name() {}
+        explicit lock_name (const std::string &name): site(&lock_profile::instance().site(name)) {}
+
+        lock_site& site_or (lock_site &call_site) const
+        {
+            return site ? *site : call_site;
+        }
+#else
+    public:
+        lock_name() {}
+        explicit lock_name (const std::string&) {}
+#endif
+    };
+
+    // what locks taken through THREAD_LOCK wait on; a profiled lock times
+    // taking the mutex back, which only the generic condition variable lets it do
+#ifdef THREAD_PROFILE_LOCKS
+    typedef std::condition_variable_any lock_condition;
+#else
+    typedef std::condition_variable lock_condition;
+#endif
+
+    // THREAD_LOCK without the profiling: a unique_lock that waits like a profiled one
+    template< typename Mutex >
+    class plain_lock : public std::unique_lock<Mutex>
+    {
+    public:
+        explicit plain_lock (Mutex &mutex): std::unique_lock<Mutex>(mutex) {}
+
+        template< typename Predicate >
+        void wait (lock_condition &cv, Predicate pred)
+        {
+            cv.wait(*this, pred);
+        }
+
+        void wait (lock_condition &cv)
+        {
+            cv.wait(*this);
+        }
+    };
+
+    // A unique_lock that counts towards its site. The hold ends while it waits
+    // on a condition variable, and taking the mutex back on waking up counts as
+    // an acquisition of its own, with its wait if it had to.
+    template< typename Mutex >
+    class profiled_lock : public std::unique_lock<Mutex>
+    {
+    private:
+        lock_site &site;
+        std::chrono::steady_clock::time_point acquired;
+
+        // what the condition variable unlocks and locks again
+        class relock
+        {
+        private:
+            profiled_lock &owner;
+
+        public:
+            relock (profiled_lock &_owner): owner(_owner) {}
+
+            void lock()
+            {
+                owner.acquire();
+            }
+
+            void unlock()
+            {
+                owner.release();
+            }
+        };
+
+        static uint64_t nanoseconds_since (std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        void acquire()
+        {
+            if (!this->try_lock())
+            {
+                const auto start = std::chrono::steady_clock::now();
+                this->lock();
+                site.add_wait(nanoseconds_since(start));
+            }
+
+            site.acquisitions.fetch_add(1, std::memory_order_relaxed);
+            acquired = std::chrono::steady_clock::now();
+        }
+
+        void release()
+        {
+            site.hold_nanoseconds.fetch_add(nanoseconds_since(acquired), std::memory_order_relaxed);
+            this->unlock();
+        }
+
+    public:
+        profiled_lock (Mutex &mutex, lock_site &_site): std::unique_lock<Mutex>(mutex, std::defer_lock), site(_site)
+        {
+            acquire();
+        }
+
+        ~profiled_lock()
+        {
+            if (this->owns_lock())
+                site.hold_nanoseconds.fetch_add(nanoseconds_since(acquired), std::memory_order_relaxed);
+        }
+
+        template< typename Predicate >
+        void wait (lock_condition &cv, Predicate pred)
+        {
+            while (!pred())
+                wait(cv);
+        }
+
+        // may wake up spuriously, like the condition variable
+        void wait (lock_condition &cv)
+        {
+            relock lock(*this);
+            cv.wait(lock);
+        }
+    };
+}
+
+// locks mutex_ for the rest of the scope as a unique_lock named lock_; the
+// site is looked up once per call site, and sites of the same name are merged.
+// THREAD_LOCK_OF counts under the lock_name owner_ instead, if it has a name
+#ifdef THREAD_PROFILE_LOCKS
+#define THREAD_LOCK(lock_, mutex_, name_) \
+    static Thread::lock_site &lock_##_site = Thread::lock_profile::instance().site(name_); \
+    Thread::profiled_lock<std::mutex> lock_(mutex_, lock_##_site)
+#define THREAD_LOCK_OF(lock_, mutex_, owner_, name_) \
+    static Thread::lock_site &lock_##_site = Thread::lock_profile::instance().site(name_); \
+    Thread::profiled_lock<std::mutex> lock_(mutex_, (owner_).site_or(lock_##_site))
+#else
+#define THREAD_LOCK(lock_, mutex_, name_) \
+    Thread::plain_lock<std::mutex> lock_(mutex_)
+#define THREAD_LOCK_OF(lock_, mutex_, owner_, name_) \
+    Thread::plain_lock<std::mutex> lock_(mutex_)
+#endif
+
+#endif // LOCKPROFILE_HPP_INCLUDED
@@ -0,0 +1,117 @@
+#ifndef MOVE_HPP_INCLUDED
+#define MOVE_HPP_INCLUDED
+
+#include <ctype.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+
+// Moves packed into one byte. Hand moves take codes 0 to 3, split moves
+// follow by increasing amount, with both directions of one amount adjacent.
+typedef unsigned char move_code;
+
+class move_data
+{
+public:
+    int fparam, sparam;
+    bool is_split;
+
+    move_data (int _fparam = 0, int _sparam = 0, bool _is_split = false):
+        fparam(_fparam), sparam(_sparam), is_split(_is_split) {}
+
+    move_code get_code() const
+    {
+        if (is_split)
+            return 4 + 2 * (abs(fparam) - 1) + (fparam < 0);
+        return 2 * (toupper(fparam) == 'R') + (toupper(sparam) == 'R');
+    }
+
+    static move_data from_code(move_code code)
+    {
+        if (code < 4)
+            return move_data(code & 2 ? 'R' : 'L', code & 1 ? 'R' : 'L');
+
+        const int amount = (code - 4) / 2 + 1;
+        return (code - 4) & 1 ? move_data(-amount, amount, true) : move_data(amount, -amount, true);
+    }
+
+    // number of codes needed for split amounts up to max_split_amount
+    static constexpr int code_count(int max_split_amount)
+    {
+        return 4 + 2 * max_split_amount;
+    }
+
+    std::string get_displayable() const
+    {
+        if (is_split)
+            return std::string("S") +
+                   (fparam < 0 ? "R" : fparam == 0 ? "-" : sparam < 0 ? "L" : "-") +
+                   (abs(fparam) == abs(sparam) ? std::to_string(abs(fparam)) : "-");
+        else
+            return std::string("") +
+                   (toupper(fparam) == 'L' || toupper(fparam) == 'R' ?
+                   (char)toupper(fparam) : '-') +
+                   (toupper(sparam) == 'L' || toupper(sparam) == 'R' ?
+                   (char)toupper(sparam) : '-');
+    }
+
+    static move_data parse_displayable(std::string displayable)
+    {
+        static const std::string error_msg = "Move parsing failed: Invalid displayable format";
+        move_data move;
+
+        for (size_t i = 0; i < displayable.length(); ++i)
+            displayable[i] = toupper(displayable[i]);
+
+        if (displayable.length() < 2)
+            throw std::runtime_error(error_msg);
+        else
+        if (displayable.length() == 2)
+        {
+            if (displayable[0] == 'L')
+                move.fparam = 'L';
+            else
+            if (displayable[0] == 'R')
+                move.fparam = 'R';
+            else
+                throw std::runtime_error(error_msg);
+
+            if (displayable[1] == 'L')
+                move.sparam = 'L';
+            else
+            if (displayable[1] == 'R')
+                move.sparam = 'R';
+            else
+                throw std::runtime_error(error_msg);
+        }
+        else
+        {
+            if (displayable[0] != 'S')
+                throw std::runtime_error(error_msg);
+            if (displayable[1] != 'L' && displayable[1] != 'R')
+                throw std::runtime_error(error_msg);
+
+            move.fparam = displayable[1] == 'L' ? 1 : -1;
+            move.sparam = displayable[1] == 'R' ? 1 : -1;
+
+            const int change = std::stoi(displayable.substr(2));
+            move.fparam *= change;
+            move.sparam *= change;
+            move.is_split = true;
+        }
+
+        if (!move.is_valid())
+            throw std::runtime_error(error_msg);
+
+        return move;
+    }
+
+    bool is_valid() const
+    {
+        return is_split ? (fparam != 0 && fparam == -sparam) :
+                         ((toupper(fparam) == 'L' || toupper(fparam) == 'R') &&
+                          (toupper(sparam) == 'L' || toupper(sparam) == 'R'));
+    }
+};
+
+#endif // MOVE_HPP_INCLUDED
@@ -0,0 +1,125 @@
+#ifndef PERFT_HPP_INCLUDED
+#define PERFT_HPP_INCLUDED
+
+#include "Move.hpp"
+#include "Rules.hpp"
+#include "State.hpp"
+#include "Thread.hpp"
+#include <algorithm>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Leaves of the game tree to a fixed depth, counted move by move. Games that
+// end early have no leaves below them, and cycles are counted as often as they
+// are walked. The counts are deterministic, so they check one move generator
+// against another and time them. The reference tries every move code through
+// state::try_make_move, the same checks as make_move and make_split_move
+// without the exceptions; the fast count goes through state::generate_moves.
+template< typename Rules >
+class BasicPerft
+{
+public:
+    typedef basic_state<Rules> state;
+    typedef std::vector<std::pair<move_data, uint64_t> > division;
+
+    // the legal moves as the rule checks find them, in the order of their codes
+    static int reference_moves (const state &game_state, move_data *moves, state *targets)
+    {
+        int count = 0;
+
+        for (int code = 0; code < state::max_move_codes(); ++code)
+        {
+            const move_data move = move_data::from_code(code);
+
+            targets[count] = game_state;
+            if (targets[count].try_make_move(move) == MOVE_LEGAL)
+                moves[count++] = move;
+        }
+
+        return count;
+    }
+
+    static int generated_moves (const state &game_state, move_data *moves, state *targets)
+    {
+        return game_state.generate_moves(moves, targets);
+    }
+
+    static uint64_t perft (const state &game_state, int depth, bool reference = false)
+    {
+        if (depth <= 0)
+            return 1;
+
+        move_data moves[state::max_moves()];
+        state targets[state::max_moves()];
+        const int count = reference ? reference_moves(game_state, moves, targets) : generated_moves(game_state, moves, targets);
+
+        // the last ply is counted without being made
+        if (depth == 1)
+            return count;
+
+        uint64_t ret = 0;
+        for (int i = 0; i < count; ++i)
+            ret += perft(targets[i], depth - 1, reference);
+
+        return ret;
+    }
+
+    // the leaves below every legal move of the root, ordered by move code
+    static division divide (const state &game_state, int depth, bool reference = false)
+    {
+        move_data moves[state::max_moves()];
+        state targets[state::max_moves()];
+        const int count = reference ? reference_moves(game_state, moves, targets) : generated_moves(game_state, moves, targets);
+
+        division ret;
+        for (int i = 0; i < count; ++i)
+            ret.push_back(std::make_pair(moves[i], perft(targets[i], depth - 1, reference)));
+
+        std::sort(ret.begin(), ret.end(), [](const std::pair<move_data, uint64_t> &a, const std::pair<move_data, uint64_t> &b) {
+            return a.first.get_code() < b.first.get_code();
+        });
+
+        return ret;
+    }
+
+    // the same count with the pool; the tree is opened breadth first until
+    // there are a few subtrees for every thread, which are then counted in parallel
+    static uint64_t perft (Thread::ThreadPool &pool, const state &game_state, int depth, bool reference = false)
+    {
+        const size_t wanted = 8 * pool.num_of_threads();
+
+        std::vector<state> frontier(1, game_state), next;
+        move_data moves[state::max_moves()];
+        state targets[state::max_moves()];
+
+        while (depth > 1 && frontier.size() < wanted)
+        {
+            next.clear();
+            for (const state &s : frontier)
+            {
+                const int count = reference ? reference_moves(s, moves, targets) : generated_moves(s, moves, targets);
+                next.insert(next.end(), targets, targets + count);
+            }
+
+            frontier.swap(next);
+            --depth;
+        }
+
+        std::vector<uint64_t> counts(frontier.size(), 0);
+        pool.add_range(0, frontier.size(), [&frontier, &counts, depth, reference](size_t i) {
+            counts[i] = perft(frontier[i], depth, reference);
+        });
+        pool.wait();
+
+        uint64_t ret = 0;
+        for (uint64_t count : counts)
+            ret += count;
+
+        return ret;
+    }
+};
+
+typedef BasicPerft<standard_rules> Perft;
+
+#endif // PERFT_HPP_INCLUDED
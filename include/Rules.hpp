@@ -0,0 +1,57 @@
+#ifndef RULES_HPP_INCLUDED
+#define RULES_HPP_INCLUDED
+
+// Rule variants as compile-time policies. state, the game graph, the solver,
+// the book and the evaluator are all templated on one of them, so every rule
+// check is a constant and the checks a variant does not need are compiled out.
+// A variant derives from standard_rules and overrides what it changes.
+
+class standard_rules
+{
+public:
+    static constexpr short white_left_hand_max  = 5;
+    static constexpr short white_right_hand_max = 5;
+    static constexpr short black_left_hand_max  = 5;
+    static constexpr short black_right_hand_max = 5;
+    static constexpr short white_split_max = -1; // negative value for unlimited splits
+    static constexpr short black_split_max = -1; // negative value for unlimited splits
+
+    static constexpr bool splits_as_moves = true;
+    static constexpr bool allow_sacrifical_splits = true;
+    static constexpr bool allow_regenerative_splits = true;
+    static constexpr bool meta_variant = false;
+};
+
+// a split may also take a hand past its maximum
+class meta_rules : public standard_rules
+{
+public:
+    static constexpr bool meta_variant = true;
+};
+
+// a split may neither empty a hand nor revive one
+class strict_split_rules : public standard_rules
+{
+public:
+    static constexpr bool allow_sacrifical_splits = false;
+    static constexpr bool allow_regenerative_splits = false;
+};
+
+// three splits per player and game
+class limited_split_rules : public standard_rules
+{
+public:
+    static constexpr short white_split_max = 3;
+    static constexpr short black_split_max = 3;
+};
+
+// the variants compiled into the engine; X is applied to each of them, which
+// is how the translation units instantiate their templates. The evaluator of
+// each variant is instantiated in a unit of its own, see src/Evaluator.inl
+#define CHOPSTICKS_RULES(X) \
+    X(standard_rules)       \
+    X(meta_rules)           \
+    X(strict_split_rules)   \
+    X(limited_split_rules)
+
+#endif // RULES_HPP_INCLUDED
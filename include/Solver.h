@@ -0,0 +1,44 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "GameGraph.h"
+#include "Move.hpp"
+#include "Rules.hpp"
+#include "State.hpp"
+#include <vector>
+
+class solved_node_data
+{
+public:
+    char winner = 'D';  // 'W' or 'B' under perfect play, 'D' for draws
+    int distance = -1;  // plies until the game ends under perfect play, -1 for draws
+    move_data best_move;
+};
+
+// Retrograde analysis of the whole game graph. Every valid state is labeled
+// with its game-theoretic value, so cycles are resolved exactly: whatever
+// cannot be forced to an end by either side is a draw.
+template< typename Rules >
+class BasicSolver
+{
+public:
+    typedef basic_state<Rules> state;
+    typedef BasicGameGraph<Rules> GameGraph;
+
+private:
+    std::vector<solved_node_data> table;
+    std::vector<bool> valid;
+    bool solved = false;
+
+public:
+    void solve (const GameGraph &graph);
+    bool is_solved() const;
+    bool has_state (int hash_state) const;
+    size_t number_of_states() const;
+    solved_node_data get_node_data (int hash_state) const;
+    solved_node_data get_node_data (const state &game_state) const;
+};
+
+typedef BasicSolver<standard_rules> Solver;
+
+#endif // SOLVER_H
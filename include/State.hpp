@@ -1,20 +1,45 @@
 #ifndef STATES_HPP_INCLUDED
 #define STATES_HPP_INCLUDED
 
+#include "Move.hpp"
+#include "Rules.hpp"
+#include <ctype.h>
 #include <math.h>
 #include <sstream>
+#include <stdint.h>
 #include <stdexcept>
 #include <string>
 
-class state
+typedef uint32_t packed_state;
+
+enum move_status
+{
+    MOVE_LEGAL = 0,
+    MOVE_INVALID_STATE,
+    MOVE_GAME_OVER,
+    MOVE_BAD_SIDES,
+    MOVE_ELIMINATED_HAND,
+    MOVE_ELIMINATED_TARGET,
+    MOVE_NO_SPLITS_LEFT,
+    MOVE_BAD_SPLIT,
+    MOVE_REGENERATIVE_SPLIT,
+    MOVE_SACRIFICIAL_SPLIT,
+    MOVE_HAND_SWITCHING_SPLIT,
+    MOVE_SUBTRACTING_SPLIT
+};
+
+// A position under the rules of a variant; see Rules.hpp.
+template< typename Rules >
+class basic_state
 {
 private:
-    void can_move() const
+    move_status check_can_move() const
     {
         if (!is_valid())
-            throw std::runtime_error("Invalid state: Game is invalid");
+            return MOVE_INVALID_STATE;
         if (is_over())
-            throw std::runtime_error("Invalid move: Game is over");
+            return MOVE_GAME_OVER;
+        return MOVE_LEGAL;
     }
 
     void after_move(bool from_split = false)
@@ -28,18 +53,41 @@ private:
             white_turn ^= 1;
     }
 
+    std::string get_error_message(move_status status, char side = '-') const
+    {
+        const std::string me = white_turn ? "WHITE" : "BLACK", op = white_turn ? "BLACK" : "WHITE";
+
+        switch (status)
+        {
+        case MOVE_INVALID_STATE:        return "Invalid state: Game is invalid";
+        case MOVE_GAME_OVER:            return "Invalid move: Game is over";
+        case MOVE_BAD_SIDES:            return "Invalid move: Sides should be L and R (case-insensitive) only";
+        case MOVE_ELIMINATED_HAND:      return std::string("Invalid move: Cannot use eliminated ") + side + "-side of " + me;
+        case MOVE_ELIMINATED_TARGET:    return std::string("Invalid move: ") + side + "-side of " + op + " has already been eliminated";
+        case MOVE_NO_SPLITS_LEFT:       return "Invalid move: No split moves remaining for " + me;
+        case MOVE_BAD_SPLIT:            return "Invalid move: split moves should consist of decreasing one side and increasing the other";
+        case MOVE_REGENERATIVE_SPLIT:   return "Invalid move: Regenerative splits are not allowed";
+        case MOVE_SACRIFICIAL_SPLIT:    return "Invalid move: Sacrificial splits are not allowed";
+        case MOVE_HAND_SWITCHING_SPLIT: return "Invalid move: Hand-switching split moves are not allowed";
+        case MOVE_SUBTRACTING_SPLIT:    return "Invalid move: Subtracting split moves are allowed in meta variant only";
+        default:                        return "Invalid move";
+        }
+    }
+
 public:
-    static const short white_left_hand_max  = 5;
-    static const short white_right_hand_max = 5;
-    static const short black_left_hand_max  = 5;
-    static const short black_right_hand_max = 5;
-    static const short white_split_max = -1; // negative value for unlimited splits
-    static const short black_split_max = -1; // negative value for unlimited splits
-
-    static const bool splits_as_moves = true;
-    static const bool allow_sacrifical_splits = true;
-    static const bool allow_regenerative_splits = true;
-    static const bool meta_variant = false;
+    typedef Rules rules;
+
+    static constexpr short white_left_hand_max  = Rules::white_left_hand_max;
+    static constexpr short white_right_hand_max = Rules::white_right_hand_max;
+    static constexpr short black_left_hand_max  = Rules::black_left_hand_max;
+    static constexpr short black_right_hand_max = Rules::black_right_hand_max;
+    static constexpr short white_split_max = Rules::white_split_max;
+    static constexpr short black_split_max = Rules::black_split_max;
+
+    static constexpr bool splits_as_moves = Rules::splits_as_moves;
+    static constexpr bool allow_sacrifical_splits = Rules::allow_sacrifical_splits;
+    static constexpr bool allow_regenerative_splits = Rules::allow_regenerative_splits;
+    static constexpr bool meta_variant = Rules::meta_variant;
 
     short white_left_hand;
     short white_right_hand;
@@ -49,18 +97,16 @@ public:
     short black_split;
     bool white_turn;
 
-    state()
-    {
-        white_left_hand     = 1;
-        white_right_hand    = 1;
-        black_left_hand     = 1;
-        black_right_hand    = 1;
-        white_split = white_split_max;
-        black_split = black_split_max;
-        white_turn          = true;
-    }
+    constexpr basic_state():
+        white_left_hand(1),
+        white_right_hand(1),
+        black_left_hand(1),
+        black_right_hand(1),
+        white_split(white_split_max),
+        black_split(black_split_max),
+        white_turn(true) {}
 
-    bool is_valid() const
+    constexpr bool is_valid() const
     {
         return
             white_left_hand  < white_left_hand_max  &&
@@ -72,11 +118,17 @@ public:
             (white_left_hand || white_right_hand || black_left_hand || black_right_hand);
     }
 
-    bool is_over() const
+    constexpr bool is_over() const
     {
         return is_valid() && (!white_left_hand && !white_right_hand) != (!black_left_hand && !black_right_hand);
     }
 
+    // hands still in the game, of both players
+    constexpr int count_hands() const
+    {
+        return !!white_left_hand + !!white_right_hand + !!black_left_hand + !!black_right_hand;
+    }
+
     char get_winner() const
     {
         if (is_valid() && is_over())
@@ -85,90 +137,85 @@ public:
         throw std::runtime_error("Invalid state: Cannot determine winners of ongoing or invalid games");
     }
 
-    void make_split_move(int left_change, int right_change)
+    // applies a split move if it is legal, otherwise leaves the state untouched
+    move_status try_make_split_move(int left_change, int right_change)
     {
-        can_move();
+        const move_status status = check_can_move();
+        if (status != MOVE_LEGAL)
+            return status;
 
         if ((white_turn ? white_split_max : black_split_max) > 0 && !(white_turn ? white_split : black_split))
-            throw std::runtime_error("Invalid move: No split moves remaining for " + std::string(white_turn ? "WHITE" : "BLACK"));
+            return MOVE_NO_SPLITS_LEFT;
 
         if (1LL * left_change * right_change >= 0)
-            throw std::runtime_error("Invalid move: split moves should consist of decreasing one side and increasing the other");
+            return MOVE_BAD_SPLIT;
 
-        bool left_decrease = left_change < 0;
+        const bool left_decrease = left_change < 0;
         left_change = abs(left_change);
         right_change = abs(right_change);
 
-        if (!allow_regenerative_splits &&
-            !((white_turn ? white_left_hand : black_left_hand) && (white_turn ? white_right_hand : black_right_hand)))
-            throw std::runtime_error("Invalid move: Regenerative splits are not allowed");
+        const short left_hand      = white_turn ? white_left_hand : black_left_hand,
+                    right_hand     = white_turn ? white_right_hand : black_right_hand,
+                    left_hand_max  = white_turn ? white_left_hand_max : black_left_hand_max,
+                    right_hand_max = white_turn ? white_right_hand_max : black_right_hand_max;
 
-        if ((left_decrease && (white_turn ? white_left_hand : black_left_hand) < left_change + !allow_sacrifical_splits) || // decrease leads to zero left hand
-           (!left_decrease && (white_turn ? white_right_hand : black_right_hand) < right_change + !allow_sacrifical_splits) || // decrease leads to zero right hand
-           (!left_decrease && !allow_sacrifical_splits && ((white_turn ? white_left_hand : black_left_hand) + left_change) % (white_turn ? white_left_hand_max : black_left_hand_max) == 0) || // increase leads to zero left hand
-            (left_decrease && !allow_sacrifical_splits && ((white_turn ? white_right_hand : black_right_hand) + right_change) % (white_turn ? white_right_hand_max : black_right_hand_max) == 0)) // increase leads to zero right hand
-            throw std::runtime_error("Invalid move: Sacrificial splits are not allowed");
+        if (!allow_regenerative_splits && !(left_hand && right_hand))
+            return MOVE_REGENERATIVE_SPLIT;
 
-        const int saved_white_left_hand  = white_left_hand,
-                  saved_white_right_hand = white_right_hand,
-                  saved_black_left_hand  = black_left_hand,
-                  saved_black_right_hand = black_right_hand;
+        if ((left_decrease && left_hand < left_change + !allow_sacrifical_splits) || // decrease leads to zero left hand
+           (!left_decrease && right_hand < right_change + !allow_sacrifical_splits) || // decrease leads to zero right hand
+           (!left_decrease && !allow_sacrifical_splits && (left_hand + left_change) % left_hand_max == 0) || // increase leads to zero left hand
+            (left_decrease && !allow_sacrifical_splits && (right_hand + right_change) % right_hand_max == 0)) // increase leads to zero right hand
+            return MOVE_SACRIFICIAL_SPLIT;
 
-        if (white_turn)
-        {
-            white_left_hand += left_change * (left_decrease ? -1 : 1);
-            white_right_hand += right_change * (!left_decrease ? -1 : 1);
-            --white_split;
-        }
-        else
-        {
-            black_left_hand += left_change * (left_decrease ? -1 : 1);
-            black_right_hand += right_change * (!left_decrease ? -1 : 1);
-            --black_split;
-        }
+        const int new_left_hand  = left_hand + left_change * (left_decrease ? -1 : 1),
+                  new_right_hand = right_hand + right_change * (!left_decrease ? -1 : 1);
 
         // check if the moves are hand-alternating
+        if (left_hand == new_right_hand && right_hand == new_left_hand)
+            return MOVE_HAND_SWITCHING_SPLIT;
+
+        if (!meta_variant && new_left_hand % left_hand_max + new_right_hand % right_hand_max != left_hand + right_hand)
+            return MOVE_SUBTRACTING_SPLIT;
+
         if (white_turn)
         {
-            if (saved_white_left_hand == white_right_hand &&
-                saved_white_right_hand == white_left_hand)
-                throw std::runtime_error("Invalid move: Hand-switching split moves are not allowed");
+            white_left_hand = new_left_hand;
+            white_right_hand = new_right_hand;
+            --white_split;
         }
         else
         {
-            if (saved_black_left_hand == black_right_hand &&
-                saved_black_right_hand == black_left_hand)
-                throw std::runtime_error("Invalid move: Hand-switching split moves are not allowed");
+            black_left_hand = new_left_hand;
+            black_right_hand = new_right_hand;
+            --black_split;
         }
 
         after_move(true);
 
-        if (!meta_variant &&
-           (white_left_hand + white_right_hand != saved_white_left_hand + saved_white_right_hand ||
-            black_left_hand + black_right_hand != saved_black_left_hand + saved_black_right_hand))
-            throw std::runtime_error("Invalid move: Subtracting split moves are allowed in meta variant only");
+        return MOVE_LEGAL;
     }
 
-    void make_move(char my_side, char op_side)
+    // applies a hand move if it is legal, otherwise leaves the state untouched
+    move_status try_make_move(char my_side, char op_side)
     {
-        can_move();
+        const move_status status = check_can_move();
+        if (status != MOVE_LEGAL)
+            return status;
 
         my_side = toupper(my_side);
         op_side = toupper(op_side);
 
         if ((my_side != 'L' && my_side != 'R') || (op_side != 'L' && op_side != 'R'))
-            throw std::runtime_error("Invalid move: Sides should be L and R (case-insensitive) only");
-
+            return MOVE_BAD_SIDES;
 
         if ((my_side == 'L' && !(white_turn ? white_left_hand : black_left_hand)) ||
             (my_side == 'R' && !(white_turn ? white_right_hand : black_right_hand)))
-            throw std::runtime_error(std::string("Invalid move: Cannot use eliminated ") +
-                                     my_side + "-side of " + (white_turn ? "WHITE" : "BLACK"));
+            return MOVE_ELIMINATED_HAND;
 
         if ((op_side == 'L' && !(!white_turn ? white_left_hand : black_left_hand)) ||
             (op_side == 'R' && !(!white_turn ? white_right_hand : black_right_hand)))
-            throw std::runtime_error(std::string("Invalid move: ") +
-                                     my_side + "-side of " + (white_turn ? "BLACK" : "WHITE") + " has already been eliminated");
+            return MOVE_ELIMINATED_TARGET;
 
         if (white_turn)
         {
@@ -188,14 +235,108 @@ public:
         }
 
         after_move();
+
+        return MOVE_LEGAL;
     }
 
-    int get_hash() const
+    move_status try_make_move(const move_data &move)
     {
-        if (!is_valid())
-            throw std::runtime_error("Invalid state: Cannot get hash of invalid games");
+        return move.is_split ? try_make_split_move(move.fparam, move.sparam) :
+                               try_make_move((char)move.fparam, (char)move.sparam);
+    }
+
+    move_status check_move(const move_data &move) const
+    {
+        basic_state tmp = *this;
+        return tmp.try_make_move(move);
+    }
+
+    bool is_legal(const move_data &move) const
+    {
+        return check_move(move) == MOVE_LEGAL;
+    }
+
+    void make_split_move(int left_change, int right_change)
+    {
+        const move_status status = try_make_split_move(left_change, right_change);
+        if (status != MOVE_LEGAL)
+            throw std::runtime_error(get_error_message(status));
+    }
+
+    void make_move(char my_side, char op_side)
+    {
+        const move_status status = try_make_move(my_side, op_side);
+        if (status != MOVE_LEGAL)
+            throw std::runtime_error(get_error_message(status, toupper(status == MOVE_ELIMINATED_HAND ? my_side : op_side)));
+    }
+
+    // upper bound of the number of legal moves in any state
+    static constexpr int max_moves()
+    {
+        return 4 + (white_left_hand_max + white_right_hand_max > black_left_hand_max + black_right_hand_max ?
+                    white_left_hand_max + white_right_hand_max : black_left_hand_max + black_right_hand_max) - 1;
+    }
+
+    // legal moves have codes in [0, max_move_codes())
+    static constexpr int max_move_codes()
+    {
+        // a split never moves more than a whole hand
+        short max_hand = white_left_hand_max;
+        if (max_hand < white_right_hand_max)
+            max_hand = white_right_hand_max;
+        if (max_hand < black_left_hand_max)
+            max_hand = black_left_hand_max;
+        if (max_hand < black_right_hand_max)
+            max_hand = black_right_hand_max;
+
+        return move_data::code_count(max_hand - 1);
+    }
+
+    // writes the legal moves, and the states they lead to if asked, into buffers
+    // of max_moves() entries; returns the number of moves written
+    int generate_moves(move_data *moves, basic_state *targets = nullptr) const
+    {
+        int count = 0;
+
+        if (check_can_move() != MOVE_LEGAL)
+            return count;
+
+        // hand moves
+        const char sides[] = { 'L', 'R' };
+        for (char my_side: sides)
+            for (char op_side: sides)
+            {
+                basic_state tmp = *this;
+                if (tmp.try_make_move(my_side, op_side) == MOVE_LEGAL)
+                {
+                    if (targets)
+                        targets[count] = tmp;
+                    moves[count++] = move_data(my_side, op_side);
+                }
+            }
+
+        // split moves
+        const short low_bound = white_turn ? -white_left_hand : -black_left_hand;
+        const short  up_bound = white_turn ? white_right_hand : black_right_hand;
+        for (short i = low_bound; i <= up_bound; ++i)
+        {
+            basic_state tmp = *this;
+            if (tmp.try_make_split_move(i, -i) == MOVE_LEGAL)
+            {
+                if (targets)
+                    targets[count] = tmp;
+                moves[count++] = move_data(i, -i, true);
+            }
+        }
+
+        return count;
+    }
 
-        int result = white_turn;
+    // packs the state into one word, which is the mixed-radix number of its
+    // fields; no validation is done, so it is cheap enough for the search loop
+    constexpr packed_state pack() const
+    {
+        packed_state result = white_turn;
 
         (result *= white_left_hand_max) += white_left_hand;
         (result *= white_right_hand_max) += white_right_hand;
@@ -210,35 +351,71 @@ public:
         return result;
     }
 
-    static state parse_hash(int hashed)
+    static constexpr basic_state unpack(packed_state packed)
     {
-        state result;
+        basic_state result;
 
         if (black_split_max > 0)
         {
-            result.black_split = hashed % (black_split_max + 1);
-            hashed /= black_split_max + 1;
+            result.black_split = packed % (black_split_max + 1);
+            packed /= black_split_max + 1;
         }
 
         if (white_split_max > 0)
         {
-            result.white_split = hashed % (white_split_max + 1);
-            hashed /= white_split_max + 1;
+            result.white_split = packed % (white_split_max + 1);
+            packed /= white_split_max + 1;
         }
 
-        result.black_right_hand = hashed % black_right_hand_max;
-        hashed /= black_right_hand_max;
+        result.black_right_hand = packed % black_right_hand_max;
+        packed /= black_right_hand_max;
+
+        result.black_left_hand = packed % black_left_hand_max;
+        packed /= black_left_hand_max;
+
+        result.white_right_hand = packed % white_right_hand_max;
+        packed /= white_right_hand_max;
 
-        result.white_right_hand = hashed % white_right_hand_max;
-        hashed /= white_right_hand_max;
+        result.white_left_hand = packed % white_left_hand_max;
+        packed /= white_left_hand_max;
 
-        result.black_left_hand = hashed % black_left_hand_max;
-        hashed /= black_left_hand_max;
+        result.white_turn = packed;
 
-        result.white_left_hand = hashed % white_left_hand_max;
-        hashed /= white_left_hand_max;
+        return result;
+    }
+
+    int get_hash() const
+    {
+        if (!is_valid())
+            throw std::runtime_error("Invalid state: Cannot get hash of invalid games");
+
+        return pack();
+    }
+
+    // all hashes of valid games lie in [0, hash_count())
+    static constexpr int hash_count()
+    {
+        int result = 2;
+
+        result *= white_left_hand_max;
+        result *= white_right_hand_max;
+        result *= black_left_hand_max;
+        result *= black_right_hand_max;
+
+        if (white_split_max > 0)
+            result *= white_split_max + 1;
+        if (black_split_max > 0)
+            result *= black_split_max + 1;
+
+        return result;
+    }
+
+    static basic_state parse_hash(int hashed)
+    {
+        if (hashed < 0 || hashed >= hash_count())
+            throw std::runtime_error("Parse error: Invalid game hash");
 
-        result.white_turn = hashed;
+        const basic_state result = unpack(hashed);
 
         if (!result.is_valid())
             throw std::runtime_error("Parse error: Invalid game hash");
@@ -246,6 +423,63 @@ public:
         return result;
     }
 
+    // bit 0 of a symmetry swaps the hands of white, bit 1 those of black; the
+    // hands of a player are interchangeable only when their maxima are equal
+    typedef unsigned char symmetry;
+
+    static constexpr symmetry symmetries()
+    {
+        return (white_left_hand_max == white_right_hand_max) | (black_left_hand_max == black_right_hand_max) << 1;
+    }
+
+    constexpr basic_state transformed(symmetry sym) const
+    {
+        basic_state result = *this;
+
+        if (sym & 1)
+        {
+            result.white_left_hand = white_right_hand;
+            result.white_right_hand = white_left_hand;
+        }
+        if (sym & 2)
+        {
+            result.black_left_hand = black_right_hand;
+            result.black_right_hand = black_left_hand;
+        }
+
+        return result;
+    }
+
+    // the representative of the state under symmetries(), with the smaller hands
+    // on the left; every symmetry is its own inverse, so the one applied also leads back
+    constexpr basic_state canonical(symmetry *applied = nullptr) const
+    {
+        const symmetry sym = ((symmetries() & 1) && white_left_hand > white_right_hand) |
+                             ((symmetries() & 2) && black_left_hand > black_right_hand) << 1;
+        if (applied)
+            *applied = sym;
+
+        return transformed(sym);
+    }
+
+    int get_canonical_hash() const
+    {
+        if (!is_valid())
+            throw std::runtime_error("Invalid state: Cannot get hash of invalid games");
+
+        return canonical().pack();
+    }
+
+    // the code of a move after the board is transformed by sym
+    static constexpr move_code transform_move(move_code code, symmetry sym, bool white_moves)
+    {
+        const bool my_swap = (white_moves ? sym : sym >> 1) & 1,
+                   op_swap = (white_moves ? sym >> 1 : sym) & 1;
+
+        // a split moves the same amount the other way
+        return code < 4 ? code ^ (my_swap << 1) ^ op_swap : code ^ my_swap;
+    }
+
     std::string get_displayable() const
     {
         const bool valid = is_valid();
@@ -283,4 +517,6 @@ public:
     }
 };
 
+typedef basic_state<standard_rules> state;
+
 #endif // STATES_HPP_INCLUDED
@@ -0,0 +1,327 @@
+#ifndef TASKDEQUE_HPP_INCLUDED
+#define TASKDEQUE_HPP_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Thread
+{
+    // A type-erased callable. Callables up to STORAGE bytes are kept inline and
+    // finished tasks go back to the free list of the thread that created them,
+    // so submitting a task allocates nothing once the free lists are warm, and a
+    // thread never holds more tasks than it has had out at once.
+    class Task
+    {
+    public:
+        static const size_t STORAGE = 48;
+
+    private:
+        typedef void (*handler)(Task&, bool);
+        struct free_list;
+
+        alignas(std::max_align_t) unsigned char storage[STORAGE];
+        handler handle;
+        Task *next;       // free list link
+        free_list *owner; // the free list of the thread that created the task
+
+        template< typename Fn >
+        static void handle_inline (Task &task, bool run)
+        {
+            Fn &fn = *reinterpret_cast<Fn*>(task.storage);
+            if (run)
+                fn();
+            fn.~Fn();
+        }
+
+        template< typename Fn >
+        static void handle_heap (Task &task, bool run)
+        {
+            Fn *fn = *reinterpret_cast<Fn**>(task.storage);
+            if (run)
+                (*fn)();
+            delete fn;
+        }
+
+        // taken from by its thread only; other threads push the tasks they finish onto
+        // returned, which the thread drains once head runs dry
+        struct free_list
+        {
+            Task *head = nullptr;
+            std::atomic<Task*> returned;
+            size_t allocated = 0; // tasks created by the thread
+
+            // once the thread has exited, the tasks still out, negated as they come back
+            std::atomic<int64_t> outstanding;
+
+            free_list(): returned(nullptr), outstanding(0) {}
+
+            static Task* orphaned()
+            {
+                return reinterpret_cast<Task*>(alignof(Task));
+            }
+
+            // the thread deletes the tasks it has, and the list goes with the last one out
+            void release()
+            {
+                size_t kept = 0;
+                for (Task *list : { head, returned.exchange(orphaned(), std::memory_order_acquire) })
+                    while (list)
+                    {
+                        Task *task = list;
+                        list = list->next;
+                        delete task;
+                        ++kept;
+                    }
+
+                const int64_t out = allocated - kept;
+                if (outstanding.fetch_add(out, std::memory_order_acq_rel) + out == 0)
+                    delete this;
+            }
+
+            // from any thread but the owner's
+            void give_back (Task *task)
+            {
+                Task *first = returned.load(std::memory_order_relaxed);
+                do
+                {
+                    if (first == orphaned())
+                    {
+                        delete task;
+                        if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                            delete this;
+                        return;
+                    }
+                    task->next = first;
+                } while (!returned.compare_exchange_weak(first, task, std::memory_order_release, std::memory_order_relaxed));
+            }
+        };
+
+        struct local_list
+        {
+            free_list *list = new free_list();
+
+            ~local_list()
+            {
+                list->release();
+            }
+        };
+
+        static free_list& local_free_list()
+        {
+            static thread_local local_list local;
+            return *local.list;
+        }
+
+        Task() {}
+
+        template< typename Fn >
+        static constexpr bool fits_inline()
+        {
+            return sizeof(Fn) <= STORAGE && alignof(Fn) <= alignof(std::max_align_t);
+        }
+
+        template< typename Fn, typename Func >
+        static void construct (Task *task, Func&& func, std::true_type)
+        {
+            new (task->storage) Fn(std::forward<Func>(func));
+            task->handle = handle_inline<Fn>;
+        }
+
+        template< typename Fn, typename Func >
+        static void construct (Task *task, Func&& func, std::false_type)
+        {
+            *reinterpret_cast<Fn**>(task->storage) = new Fn(std::forward<Func>(func));
+            task->handle = handle_heap<Fn>;
+        }
+
+    public:
+        // non-copyable
+        Task (const Task&) = delete;
+        Task& operator= (const Task&) = delete;
+
+        template< typename Func >
+        static Task* create (Func&& func)
+        {
+            typedef typename std::decay<Func>::type Fn;
+
+            free_list &list = local_free_list();
+            if (!list.head)
+                list.head = list.returned.exchange(nullptr, std::memory_order_acquire);
+
+            Task *task = list.head;
+            if (task)
+                list.head = task->next;
+            else
+            {
+                task = new Task();
+                task->owner = &list;
+                ++list.allocated;
+            }
+
+            construct<Fn>(task, std::forward<Func>(func), std::integral_constant<bool, fits_inline<Fn>()>());
+
+            return task;
+        }
+
+        // runs the task if asked, then hands it back to the free list it came from
+        static void finish (Task *task, bool run = true)
+        {
+            task->handle(*task, run);
+
+            free_list &list = local_free_list();
+            if (task->owner == &list)
+            {
+                task->next = list.head;
+                list.head = task;
+            }
+            else
+                task->owner->give_back(task);
+        }
+    };
+
+    // The Chase-Lev work-stealing deque, after Le et al., "Correct and
+    // Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013). Only the
+    // owning thread may push and take at the bottom; any thread may steal
+    // from the top.
+    class TaskDeque
+    {
+    private:
+        struct ring
+        {
+            int64_t capacity;
+            std::unique_ptr<std::atomic<Task*>[]> items;
+
+            ring (int64_t _capacity): capacity(_capacity), items(new std::atomic<Task*>[_capacity]) {}
+
+            Task* get (int64_t i) const
+            {
+                return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+            }
+
+            void put (int64_t i, Task *task)
+            {
+                items[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+            }
+        };
+
+        // thieves hit top and the owner hits bottom, so keep them on separate cache lines
+        std::atomic<int64_t> top;
+        char padding[64];
+        std::atomic<int64_t> bottom;
+        std::atomic<ring*> array;
+
+        // thieves may still read from rings that have been outgrown, so they live as long as the deque
+        std::vector<std::unique_ptr<ring> > rings;
+
+        ring* grow (ring *old, int64_t b, int64_t t)
+        {
+            rings.push_back(std::unique_ptr<ring>(new ring(old->capacity * 2)));
+            ring *bigger = rings.back().get();
+
+            for (int64_t i = t; i < b; ++i)
+                bigger->put(i, old->get(i));
+
+            array.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+    public:
+        TaskDeque (int64_t capacity = 256): top(0), bottom(0)
+        {
+            rings.push_back(std::unique_ptr<ring>(new ring(capacity)));
+            array.store(rings.back().get(), std::memory_order_relaxed);
+        }
+
+        // non-copyable
+        TaskDeque (const TaskDeque&) = delete;
+        TaskDeque& operator= (const TaskDeque&) = delete;
+
+        // owner only
+        void push (Task *task)
+        {
+            push_range(&task, &task + 1);
+        }
+
+        // owner only; the whole range becomes visible to thieves at once
+        void push_range (Task* const *first, Task* const *last)
+        {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            ring *a = array.load(std::memory_order_relaxed);
+
+            const int64_t count = last - first;
+            while (b - t + count > a->capacity)
+                a = grow(a, b, t);
+
+            for (int64_t i = 0; i < count; ++i)
+                a->put(b + i, first[i]);
+
+            bottom.store(b + count, std::memory_order_release);
+        }
+
+        // owner only; returns nullptr if empty
+        Task* take()
+        {
+            const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            ring *a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Task *task = a->get(b);
+            if (t == b)
+            {
+                // the last task, race the thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    task = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            return task;
+        }
+
+        // any thread; returns nullptr if empty or if another thread won the race
+        Task* steal()
+        {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return nullptr;
+
+            Task *task = array.load(std::memory_order_acquire)->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+
+            return task;
+        }
+
+        size_t size() const
+        {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_relaxed);
+            return b > t ? b - t : 0;
+        }
+
+        bool empty() const
+        {
+            return !size();
+        }
+    };
+}
+
+#endif // TASKDEQUE_HPP_INCLUDED
@@ -1,37 +1,47 @@
 #ifndef THREAD_HPP_INCLUDED
 #define THREAD_HPP_INCLUDED
 
-#include <algorithm>
+#include "LockProfile.hpp"
+#include "TaskDeque.hpp"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <conio.h>
+#include <deque>
 #include <functional>
 #include <future>
-#include <iostream>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
+#include <stdint.h>
 #include <stdlib.h>
 #include <thread>
 #include <vector>
 
 namespace Thread
 {
+    // A value guarded by a mutex, with a condition variable to wait for it.
+    // LightAtomic in LightAtomic.hpp does the same in a few bytes.
     template< typename T, typename Comparator = std::not_equal_to<T> >
     class Atomic
     {
     private:
         mutable std::mutex mutex;
-        mutable std::condition_variable cv;
+        mutable lock_condition cv;
         T state;
         Comparator comp;
+        lock_name name;
 
     public:
         typedef std::function<void(const T&)> access_fn;
         typedef std::function<void(T&)> mutator_fn;
 
-        Atomic (Comparator _comp = std::not_equal_to<T>()): comp(_comp) {}
+        Atomic (Comparator _comp = std::not_equal_to<T>()): state(), comp(_comp) {}
         Atomic (const T& _state, Comparator _comp = std::not_equal_to<T>()): state(_state), comp(_comp) {}
         Atomic (T&& _state, Comparator _comp = std::not_equal_to<T>()): state(std::move(_state)), comp(_comp) {}
 
+        // counts its locks under its own name in the lock profile
+        Atomic (const T& _state, lock_name _name, Comparator _comp = std::not_equal_to<T>()): state(_state), comp(_comp), name(_name) {}
+
         // non-copyable
         Atomic (const Atomic&) = delete;
         Atomic& operator= (const Atomic&) = delete;
@@ -45,9 +55,9 @@ namespace Thread
             if (comp(get(), state))
                 return;
 
-            std::unique_lock<std::mutex> safe(mutex);
-            cv.wait(safe, [=]() bool {
-                return comp(get(), state);
+            THREAD_LOCK_OF(safe, mutex, name, "Atomic::wait_until_cond");
+            safe.wait(cv, [&]() -> bool {
+                return comp(this->state, state);
             });
         }
 
@@ -55,7 +65,7 @@ namespace Thread
         {
             if (comp(get(), state))
             {
-                std::unique_lock<std::mutex> safe(mutex);
+                THREAD_LOCK_OF(safe, mutex, name, "Atomic::set");
                 this->state = state;
                 cv.notify_all();
             }
@@ -65,7 +75,7 @@ namespace Thread
         {
             if (comp(get(), state))
             {
-                std::unique_lock<std::mutex> safe(mutex);
+                THREAD_LOCK_OF(safe, mutex, name, "Atomic::set");
                 this->state = std::move(state);
                 cv.notify_all();
             }
@@ -73,101 +83,266 @@ namespace Thread
 
         T get() const
         {
-            std::unique_lock<std::mutex> safe(mutex);
+            THREAD_LOCK_OF(safe, mutex, name, "Atomic::get");
             return state;
         }
 
         void access (access_fn fn) const
         {
-            std::unique_lock<std::mutex> safe(mutex);
+            THREAD_LOCK_OF(safe, mutex, name, "Atomic::access");
             fn(state);
             cv.notify_all();
         }
 
         void mutate (mutator_fn fn)
         {
-            std::unique_lock<std::mutex> safe(mutex);
+            THREAD_LOCK_OF(safe, mutex, name, "Atomic::mutate");
             fn(state);
             cv.notify_all();
         }
     };
 
+    class TaskGroup;
+
+    // A work-stealing pool. Every worker owns a Chase-Lev deque: tasks spawned
+    // by a worker go to the bottom of its own deque without locking, idle
+    // workers steal from the top of the others. Tasks from threads outside the
+    // pool go through a shared queue.
     class ThreadPool
     {
+        friend class TaskGroup;
+
     private:
-        typedef std::function<void()> Task;
+        struct worker_info
+        {
+            ThreadPool *pool = nullptr;
+            size_t index = 0;
+        };
+
+        // time a worker spent asleep, padded so that the workers do not share a cache line;
+        // only the worker writes it, and the sequence is odd while it does
+        struct idle_time
+        {
+            std::atomic<uint32_t> sequence{0};
+            std::atomic<uint64_t> nanoseconds{0}; // of the sleeps that have ended
+            std::atomic<int64_t> asleep_since{0}; // of the sleep going on, 0 while awake
+            char padding[64];
+        };
 
         size_t _num_of_threads;
         std::vector<std::thread> threads;
-        std::queue<Task> tasks;
-        std::mutex mutex;
-        std::condition_variable cv;
-        Atomic<size_t> num_of_waiting_threads;
-        Atomic<bool> terminated, paused;
+        std::vector<std::unique_ptr<TaskDeque> > deques;
+        std::deque<Task*> injected; // tasks from outside the pool
+        mutable std::mutex mutex;   // guards injected and sleeping workers
+        std::unique_ptr<idle_time[]> idle;
+        lock_condition cv;
+        std::atomic<size_t> pending;  // tasks submitted but not finished yet
+        std::atomic<size_t> sleeping; // threads blocked on cv
+        std::atomic<bool> terminated, paused;
+
+        static worker_info& this_worker()
+        {
+            static thread_local worker_info info;
+            return info;
+        }
 
         void check_terminated()
         {
-            if (terminated.get())
+            if (terminated.load())
                 throw std::runtime_error("Thread pool has been terminated before");
         }
 
-        // a wrapper that acquires and completes the tasks
-        static void caller(ThreadPool *pool)
+        bool has_task() const
         {
-            while (true)
+            if (!injected.empty())
+                return true;
+            for (auto &deque: deques)
+                if (!deque->empty())
+                    return true;
+            return false;
+        }
+
+        // own deque first, then the shared queue, then the other workers
+        Task* find_task (size_t index, unsigned &seed)
+        {
+            Task *task = index < deques.size() ? deques[index]->take() : nullptr;
+            if (task)
+                return task;
+
             {
-                // if terminated, end the loop/thread
-                if (pool->terminated.get())
-                    break;
+                THREAD_LOCK(lock, mutex, "ThreadPool::find_task");
+                if (!injected.empty())
+                {
+                    task = injected.front();
+                    injected.pop_front();
+                    return task;
+                }
+            }
 
-                std::unique_lock<std::mutex> lock(pool->mutex, std::defer_lock);
+            seed = seed * 1103515245 + 12345;
+            const size_t start = (seed >> 16) % _num_of_threads;
+            for (size_t i = 0; i < _num_of_threads; ++i)
+            {
+                const size_t victim = (start + i) % _num_of_threads;
+                if (victim != index && (task = deques[victim]->steal()))
+                    return task;
+            }
 
-                // if paused or out of tasks, wait
-                if (pool->tasks.empty() || pool->paused.get())
+            return nullptr;
+        }
+
+        void run (Task *task)
+        {
+            Task::finish(task);
+            if (pending.fetch_sub(1) == 1)
+                notify();
+        }
+
+        void notify()
+        {
+            // pairs with the fences in caller and wait_until, so either we see the sleeper or it sees the change
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping.load())
+            {
+                THREAD_LOCK(lock, mutex, "ThreadPool::notify");
+                cv.notify_all();
+            }
+        }
+
+        void submit (Task* const *first, Task* const *last)
+        {
+            pending.fetch_add(last - first);
+
+            const worker_info &me = this_worker();
+            if (me.pool == this)
+                deques[me.index]->push_range(first, last);
+            else
+            {
+                THREAD_LOCK(lock, mutex, "ThreadPool::submit");
+                injected.insert(injected.end(), first, last);
+            }
+
+            notify();
+        }
+
+        // blocks until done() holds; workers run tasks in the meantime instead of sleeping
+        template< typename Predicate >
+        void wait_until (Predicate done)
+        {
+            const worker_info &me = this_worker();
+            const bool helping = me.pool == this;
+            unsigned seed = me.index;
+
+            while (!done() && !terminated.load())
+            {
+                if (helping && !paused.load())
                 {
-                    pool->num_of_waiting_threads.mutate([](size_t &old) { ++old; });
-                    pool->cv.wait(lock, [=]() {
-                        return pool->terminated.get() || !(pool->tasks.empty() || pool->paused.get());
-                    });
-                    pool->num_of_waiting_threads.mutate([](size_t &old) { --old; });
+                    Task *task = find_task(me.index, seed);
+                    if (task)
+                    {
+                        run(task);
+                        continue;
+                    }
                 }
 
-                // if terminated once again, end the loop/thread
-                if (pool->terminated.get())
-                    break;
+                THREAD_LOCK(lock, mutex, "ThreadPool::wait_until");
+                sleeping.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (helping)
+                    fall_asleep(me.index);
+                lock.wait(cv, [&]() {
+                    return done() || terminated.load() || (helping && !paused.load() && has_task());
+                });
+                if (helping)
+                    wake_up(me.index);
+                sleeping.fetch_sub(1);
+            }
+        }
 
-                // take next task
-                auto task = std::move(pool->tasks.front());
-                pool->tasks.pop();
+        static int64_t now_nanoseconds()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
 
-                lock.unlock();
+        // only the worker itself writes its counters, so plain stores will do
+        void fall_asleep (size_t index)
+        {
+            idle_time &t = idle[index];
+            t.sequence.store(t.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            t.asleep_since.store(now_nanoseconds(), std::memory_order_relaxed);
+            t.sequence.store(t.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        void wake_up (size_t index)
+        {
+            idle_time &t = idle[index];
+            const int64_t slept = now_nanoseconds() - t.asleep_since.load(std::memory_order_relaxed);
+            t.sequence.store(t.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            t.nanoseconds.store(t.nanoseconds.load(std::memory_order_relaxed) + slept, std::memory_order_relaxed);
+            t.asleep_since.store(0, std::memory_order_relaxed);
+            t.sequence.store(t.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // a wrapper that acquires and completes the tasks
+        static void caller (ThreadPool *pool, size_t index)
+        {
+            this_worker().pool = pool;
+            this_worker().index = index;
+            unsigned seed = index;
 
-                task();
+            while (true)
+            {
+                // if terminated, end the loop/thread
+                if (pool->terminated.load())
+                    break;
+
+                Task *task = pool->paused.load() ? nullptr : pool->find_task(index, seed);
+                if (task)
+                {
+                    pool->run(task);
+                    continue;
+                }
+
+                // if paused or out of tasks, wait
+                THREAD_LOCK(lock, pool->mutex, "ThreadPool::sleep");
+                pool->sleeping.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                pool->fall_asleep(index);
+                lock.wait(pool->cv, [=]() {
+                    return pool->terminated.load() || !(pool->paused.load() || !pool->has_task());
+                });
+                pool->wake_up(index);
+                pool->sleeping.fetch_sub(1);
             }
         }
 
     public:
-        ThreadPool (size_t __num_of_threads = 0): num_of_waiting_threads(0), terminated(false), paused(false)
+        ThreadPool (size_t __num_of_threads = 0): pending(0), sleeping(0), terminated(false), paused(false)
         {
             _num_of_threads = __num_of_threads ? __num_of_threads : std::thread::hardware_concurrency();
+            idle.reset(new idle_time[_num_of_threads]);
 
-            std::cout << "Starting " << _num_of_threads << " thread" << (_num_of_threads > 1 ? "s" : "") << "... ";
+            for (size_t i = 0; i < _num_of_threads; ++i)
+                deques.push_back(std::unique_ptr<TaskDeque>(new TaskDeque()));
 
             threads.reserve(_num_of_threads);
-            std::generate_n(std::back_inserter(threads), _num_of_threads, [this]() { return std::thread(caller, this); });
-
-            std::cout << "Done" << std::endl
-                      << "Press any key to continue... ";
-            getch();
+            for (size_t i = 0; i < _num_of_threads; ++i)
+                threads.push_back(std::thread(caller, this, i));
         }
 
         ~ThreadPool()
         {
-            clear();
+            if (!terminated.load())
+                clear();
 
             // notify all threads to terminate
-            terminated.set(true);
-            cv.notify_all();
+            {
+                THREAD_LOCK(lock, mutex, "ThreadPool::terminate");
+                terminated.store(true);
+                cv.notify_all();
+            }
 
             // join all threads
             for (auto &thread: threads)
@@ -179,27 +354,45 @@ namespace Thread
         ThreadPool (const ThreadPool&) = delete;
         ThreadPool& operator= (const ThreadPool&) = delete;
 
-        // movable
-        ThreadPool (ThreadPool&&) = default;
-        ThreadPool& operator= (ThreadPool&&) = default;
+        // fire-and-forget; no allocation for small callables once the pool is warm
+        template< typename Func >
+        void spawn (Func&& func)
+        {
+            check_terminated();
 
-        template< typename Func, typename... Args >
-        auto add (Func&& func, Args&&... args) -> std::future<typename std::result_of<Func(Args...)>::type>
+            Task *task = Task::create(std::forward<Func>(func));
+            submit(&task, &task + 1);
+        }
+
+        // spawns func(i) for every i in [first, last) in one go; every task gets its own copy of func
+        template< typename Func >
+        void add_range (size_t first, size_t last, const Func &func)
         {
             check_terminated();
 
+            if (first >= last)
+                return;
+
+            // kept by the thread from one call to the next, so that splitting allocates nothing either
+            static thread_local std::vector<Task*> tasks;
+            tasks.clear();
+            for (size_t i = first; i < last; ++i)
+                tasks.push_back(Task::create([func, i]() { func(i); }));
+
+            submit(tasks.data(), tasks.data() + tasks.size());
+        }
+
+        // for callers that want the result; the future and the bound call are allocated every
+        // time, so the search goes through spawn and add_range instead
+        template< typename Func, typename... Args >
+        auto add (Func&& func, Args&&... args) -> std::future<typename std::result_of<Func(Args...)>::type>
+        {
             typedef std::packaged_task<typename std::result_of<Func(Args...)>::type()> PackagedTask;
 
             auto task = std::make_shared<PackagedTask>(std::bind(std::forward<Func>(func), std::forward<Args>(args)...));
 
             auto ret = task->get_future();
-            {
-                std::unique_lock<std::mutex> lock(mutex);
-                tasks.emplace([task]() { (*task)(); });
-            }
-
-            // let one waiting thread know there is an available job
-            cv.notify_one();
+            spawn([task]() { (*task)(); });
 
             return ret;
         }
@@ -207,55 +400,201 @@ namespace Thread
         void terminate()
         {
             check_terminated();
-            terminated.set(true);
+
+            THREAD_LOCK(lock, mutex, "ThreadPool::terminate");
+            terminated.store(true);
             cv.notify_all();
         }
 
         bool pause()
         {
             check_terminated();
-            return paused.get();
+            return paused.load();
         }
 
         void pause (bool flag)
         {
             check_terminated();
 
-            if (paused.get() != flag)
+            if (paused.exchange(flag) != flag)
             {
-                paused.set(flag);
+                THREAD_LOCK(lock, mutex, "ThreadPool::pause");
                 cv.notify_all();
             }
         }
 
+        // blocks until every task in the pool is done
         void wait()
         {
             check_terminated();
-
-            // wait until all threads are waiting and all tasks are done
-            while (num_of_waiting_threads.get() != _num_of_threads || num_of_waiting_tasks());
+            wait_until([this]() { return !pending.load(); });
         }
 
         void clear()
         {
             check_terminated();
 
-            std::lock_guard<std::mutex> lock(mutex);
-            while (!tasks.empty())
-                tasks.pop();
+            std::vector<Task*> dropped;
+            {
+                THREAD_LOCK(lock, mutex, "ThreadPool::clear");
+                dropped.assign(injected.begin(), injected.end());
+                injected.clear();
+            }
+
+            // a steal that loses the race to another thread comes back empty, so try again until nothing is left
+            for (auto &deque: deques)
+                while (!deque->empty())
+                    if (Task *task = deque->steal())
+                        dropped.push_back(task);
+
+            for (Task *task: dropped)
+                Task::finish(task, false);
+            if (!dropped.empty() && pending.fetch_sub(dropped.size()) == dropped.size())
+                notify();
         }
 
-        size_t num_of_threads()
+        size_t num_of_threads() const
         {
             return _num_of_threads;
         }
 
-        size_t num_of_waiting_tasks()
+        size_t num_of_waiting_tasks() const
         {
-            check_terminated();
+            if (terminated.load())
+                throw std::runtime_error("Thread pool has been terminated before");
+
+            size_t ret = 0;
+            for (auto &deque: deques)
+                ret += deque->size();
+
+            THREAD_LOCK(lock, mutex, "ThreadPool::num_of_waiting_tasks");
+            return ret + injected.size();
+        }
+
+        // the index of the calling worker, or num_of_threads() for threads outside the pool
+        size_t worker_index() const
+        {
+            const worker_info &me = this_worker();
+            return me.pool == this ? me.index : _num_of_threads;
+        }
 
-            std::lock_guard<std::mutex> lock(mutex);
-            return tasks.size();
+        // the time the workers have spent asleep, waiting for tasks, since the pool started,
+        // up to now for the workers still asleep; the difference of two calls is the idle time in between
+        double idle_seconds() const
+        {
+            const int64_t now = now_nanoseconds();
+
+            uint64_t ret = 0;
+            for (size_t i = 0; i < _num_of_threads; ++i)
+            {
+                const idle_time &t = idle[i];
+                while (true)
+                {
+                    const uint32_t before = t.sequence.load(std::memory_order_acquire);
+                    const uint64_t slept = t.nanoseconds.load(std::memory_order_relaxed);
+                    const int64_t since = t.asleep_since.load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+
+                    if (!(before & 1) && t.sequence.load(std::memory_order_relaxed) == before)
+                    {
+                        ret += slept + (since && now > since ? now - since : 0);
+                        break;
+                    }
+
+                    std::this_thread::yield();
+                }
+            }
+
+            return ret * 1e-9;
+        }
+    };
+
+    // A set of tasks that are waited for and cancelled together. Cancelling
+    // skips the tasks that have not started yet, running ones may poll
+    // is_cancelled() to stop early. Waiting clears the cancellation, so the
+    // group can be reused.
+    class TaskGroup
+    {
+    private:
+        ThreadPool &pool;
+        std::atomic<size_t> pending;
+        std::atomic<bool> cancelled;
+
+        void finish()
+        {
+            // the group may be gone as soon as pending drops to zero, so nothing of it is touched after that
+            ThreadPool &owner = pool;
+            if (pending.fetch_sub(1) == 1)
+                owner.notify();
+        }
+
+    public:
+        TaskGroup (ThreadPool &_pool): pool(_pool), pending(0), cancelled(false) {}
+
+        ~TaskGroup()
+        {
+            // the tasks refer to the group
+            pool.wait_until([this]() { return !pending.load(); });
+        }
+
+        // non-copyable
+        TaskGroup (const TaskGroup&) = delete;
+        TaskGroup& operator= (const TaskGroup&) = delete;
+
+        template< typename Func >
+        void spawn (Func&& func)
+        {
+            pool.check_terminated();
+
+            // a cancel() left over from before the group went idle does not reach the new tasks
+            if (!pending.fetch_add(1))
+                cancelled.store(false);
+            pool.spawn([this, fn = std::forward<Func>(func)]() mutable {
+                if (!cancelled.load())
+                    fn();
+                finish();
+            });
+        }
+
+        template< typename Func >
+        void add_range (size_t first, size_t last, const Func &func)
+        {
+            pool.check_terminated();
+
+            if (first >= last)
+                return;
+
+            if (!pending.fetch_add(last - first))
+                cancelled.store(false);
+            pool.add_range(first, last, [this, func](size_t i) {
+                if (!cancelled.load())
+                    func(i);
+                finish();
+            });
+        }
+
+        void wait()
+        {
+            pool.check_terminated();
+            pool.wait_until([this]() { return !pending.load(); });
+            cancelled.store(false);
+        }
+
+        // the tasks not started yet are dropped; running ones see is_cancelled() and may give up early.
+        // It lasts until the group is idle again: until wait() returns, or until the next spawn
+        void cancel()
+        {
+            cancelled.store(true);
+        }
+
+        bool is_cancelled() const
+        {
+            return cancelled.load();
+        }
+
+        size_t num_of_pending_tasks() const
+        {
+            return pending.load();
         }
     };
 }
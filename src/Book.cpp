@@ -0,0 +1,205 @@
+#include "Book.h"
+#include <fstream>
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+template< typename Rules >
+book_header BasicBook<Rules>::expected_header()
+{
+    book_header header;
+    memset(&header, 0, sizeof(header));
+
+    memcpy(header.magic, "CHOPBOOK", sizeof(header.magic));
+    header.version = BOOK_VERSION;
+    header.entry_size = sizeof(book_entry);
+    header.hand_max[0] = state::white_left_hand_max;
+    header.hand_max[1] = state::white_right_hand_max;
+    header.hand_max[2] = state::black_left_hand_max;
+    header.hand_max[3] = state::black_right_hand_max;
+    header.split_max[0] = state::white_split_max;
+    header.split_max[1] = state::black_split_max;
+    header.splits_as_moves = state::splits_as_moves;
+    header.allow_sacrifical_splits = state::allow_sacrifical_splits;
+    header.allow_regenerative_splits = state::allow_regenerative_splits;
+    header.meta_variant = state::meta_variant;
+    header.hash_count = state::hash_count();
+
+    return header;
+}
+
+template< typename Rules >
+BasicBook<Rules>::~BasicBook()
+{
+    close();
+}
+
+template< typename Rules >
+void BasicBook<Rules>::write (const std::string &path, const Solver &solver)
+{
+    if (!solver.is_solved())
+        throw std::runtime_error("Cannot write a solution book from an unsolved game");
+
+    const book_header header = expected_header();
+
+    std::vector<book_entry> table(header.hash_count);
+    for (int hash = 0; hash < (int)header.hash_count; ++hash)
+    {
+        book_entry &entry = table[hash];
+        memset(&entry, 0, sizeof(entry));
+
+        if (!solver.has_state(hash))
+            continue;
+
+        const solved_node_data node = solver.get_node_data(hash);
+        entry.winner = node.winner;
+        entry.best_move = node.best_move.get_code();
+        entry.distance = node.distance;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(book_entry));
+
+    if (!out)
+        throw std::runtime_error("Cannot write the solution book to " + path);
+}
+
+template< typename Rules >
+bool BasicBook<Rules>::open (const std::string &path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    file = handle;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || !size.QuadPart || !(mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL)))
+    {
+        close();
+        throw std::runtime_error("Cannot map the solution book " + path);
+    }
+
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    length = size.QuadPart;
+#else
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(file, &info) || !info.st_size)
+    {
+        close();
+        throw std::runtime_error("Cannot map the solution book " + path);
+    }
+
+    void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    data = view == MAP_FAILED ? nullptr : static_cast<const char*>(view);
+    length = info.st_size;
+#endif
+
+    if (!data)
+    {
+        close();
+        throw std::runtime_error("Cannot map the solution book " + path);
+    }
+
+    // the header has to match the rules this program was built with, field by field
+    const book_header expected = expected_header();
+    if (length < sizeof(book_header) || memcmp(data, expected.magic, sizeof(expected.magic)))
+    {
+        close();
+        throw std::runtime_error("Not a solution book: " + path);
+    }
+    if (memcmp(data, &expected, sizeof(book_header)))
+    {
+        close();
+        throw std::runtime_error("The solution book " + path + " was written by another version or for other rules");
+    }
+    if (length != sizeof(book_header) + expected.hash_count * sizeof(book_entry))
+    {
+        close();
+        throw std::runtime_error("The solution book " + path + " is truncated");
+    }
+
+    entries = reinterpret_cast<const book_entry*>(data + sizeof(book_header));
+    return true;
+}
+
+template< typename Rules >
+void BasicBook<Rules>::close()
+{
+#ifdef _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    mapping = file = nullptr;
+#else
+    if (data)
+        munmap(const_cast<char*>(data), length);
+    if (file >= 0)
+        ::close(file);
+    file = -1;
+#endif
+
+    data = nullptr;
+    length = 0;
+    entries = nullptr;
+}
+
+template< typename Rules >
+bool BasicBook<Rules>::is_open() const
+{
+    return entries != nullptr;
+}
+
+template< typename Rules >
+bool BasicBook<Rules>::has_state (int hash_state) const
+{
+    return entries && hash_state >= 0 && hash_state < state::hash_count() && entries[hash_state].winner;
+}
+
+template< typename Rules >
+size_t BasicBook<Rules>::number_of_states() const
+{
+    size_t ret = 0;
+    for (int hash = 0; hash < state::hash_count(); ++hash)
+        ret += has_state(hash);
+    return ret;
+}
+
+template< typename Rules >
+solved_node_data BasicBook<Rules>::get_node_data (int hash_state) const
+{
+    if (!has_state(hash_state))
+        throw std::runtime_error("Unknown game state: The state is not in the solution book");
+
+    const book_entry &entry = entries[hash_state];
+
+    solved_node_data ret;
+    ret.winner = entry.winner;
+    ret.distance = entry.distance;
+    ret.best_move = move_data::from_code(entry.best_move);
+
+    return ret;
+}
+
+// every variant in Rules.hpp
+#define INSTANTIATE(Rules) template class BasicBook<Rules>;
+CHOPSTICKS_RULES(INSTANTIATE)
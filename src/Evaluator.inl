@@ -0,0 +1,674 @@
+#ifndef EVALUATOR_INL
+#define EVALUATOR_INL
+
+// The definitions of BasicEvaluator, included by one translation unit per
+// rules variant. The search of each variant gets a unit of its own, because
+// GCC stops inlining once a unit has grown past its budget, and several
+// variants in one unit slow every one of them down by a third.
+
+#include "Evaluator.h"
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <thread>
+
+template< typename Rules >
+BasicEvaluator<Rules>::BasicEvaluator (bool _use_solver, size_t num_of_threads, bool _use_symmetry): use_solver(_use_solver),
+                                                                                 use_symmetry(_use_symmetry),
+                                                                                 table(2 * state::hash_count()),
+                                                                                 Pool(num_of_threads),
+                                                                                 stopped(false),
+                                                                                 state_evaluated(0),
+                                                                                 stats(new thread_stats[Pool.num_of_threads() + 1]),
+                                                                                 histories(new move_history[Pool.num_of_threads() + 1]),
+                                                                                 started(std::chrono::steady_clock::now()),
+                                                                                 pondering(Pool)
+{
+    if (use_solver)
+        solver.solve(graph);
+}
+
+template< typename Rules >
+BasicEvaluator<Rules>::~BasicEvaluator()
+{
+    stop_pondering();
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::calculate_original_score (state current, evaluating_node_data &node)
+{
+    node.score = SPLIT_PENALTY * (
+                     (current.white_split_max > 0 ? ((double)current.white_split / current.white_split_max) : 1.0)
+                 -
+                     (current.black_split_max > 0 ? ((double)current.black_split / current.black_split_max) : 1.0)
+                 );
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::after_search (std::pair<move_code, state> move, search_node &node, bool maximizing)
+{
+    const evaluating_node_data child = table.get(move.second.pack());
+    const double score = child.score;
+
+    THREAD_LOCK(lock, node.mutex, "Evaluator::after_search");
+
+    if (maximizing)
+    {
+        if (-node.score + score > EPSILON)
+        {
+            node.score = score;
+            node.improved = true;
+            node.best_move = move.first;
+        }
+
+        node.alpha.store(std::max(node.alpha.load(), node.score));
+    }
+    else
+    {
+        if (-node.score + score < -EPSILON)
+        {
+            node.score = score;
+            node.improved = true;
+            node.best_move = move.first;
+        }
+
+        node.beta.store(std::min(node.beta.load(), node.score));
+    }
+
+    node.evaluated_moves |= 1ULL << move.first;
+
+    // the child left out moves back into the path above it
+    if (child.cyclic)
+        node.cycle_ply = std::min(node.cycle_ply, child.cycle_ply);
+}
+
+template< typename Rules >
+bool BasicEvaluator<Rules>::is_solved (int hash_state) const
+{
+    return book.has_state(hash_state) || (use_solver && solver.has_state(hash_state));
+}
+
+template< typename Rules >
+bool BasicEvaluator<Rules>::out_of_budget (size_t evaluated) const
+{
+    if (!limited)
+        return false;
+
+    if (limits.states && evaluated > limits.states)
+        return true;
+
+    // the clock is read every few hundred states only
+    return limits.seconds > 0 && !(evaluated & 255) && std::chrono::steady_clock::now() >= deadline;
+}
+
+template< typename Rules >
+typename BasicEvaluator<Rules>::thread_stats& BasicEvaluator<Rules>::local_stats()
+{
+    return stats[Pool.worker_index()];
+}
+
+// the state the table keeps for current and its mirror images
+template< typename Rules >
+typename BasicEvaluator<Rules>::state BasicEvaluator<Rules>::canonical (const state &current, typename state::symmetry *applied) const
+{
+    if (use_symmetry)
+        return current.canonical(applied);
+
+    if (applied)
+        *applied = 0;
+    return current;
+}
+
+template< typename Rules >
+typename BasicEvaluator<Rules>::move_history& BasicEvaluator<Rules>::local_history()
+{
+    return histories[Pool.worker_index()];
+}
+
+// the best move the table has first, then the moves that win at once, then the moves that
+// leave the mover more hands than the opponent, each group with the killers of the ply
+// first and the rest by their history; nodes have a handful of moves, so an insertion sort will do
+template< typename Rules >
+void BasicEvaluator<Rules>::order_moves (const state &current, std::vector<std::pair<move_code, state> > &moves, int table_move, size_t ply)
+{
+    const move_history &local = local_history();
+    const char mover = current.white_turn ? 'W' : 'B';
+    const int *killers = ply < MAX_DEPTH ? local.killers[ply] : nullptr;
+
+    // every group gets a band of its own, history stays below HISTORY_MAX
+    const int band = 4 * HISTORY_MAX;
+    int scores[state::max_moves()];
+
+    for (size_t i = 0; i < moves.size(); ++i)
+    {
+        const move_code code = moves[i].first;
+        const state &next = moves[i].second;
+
+        if (code == table_move)
+            scores[i] = 2 * band;
+        else if (next.is_over() && next.get_winner() == mover)
+            scores[i] = band;
+        else
+        {
+            const int white_hands = !!next.white_left_hand + !!next.white_right_hand,
+                      black_hands = !!next.black_left_hand + !!next.black_right_hand;
+            const bool ahead = current.white_turn ? white_hands > black_hands : black_hands > white_hands;
+            const bool killer = killers && (code == killers[0] || code == killers[1]);
+
+            scores[i] = ahead * 2 * HISTORY_MAX + killer * HISTORY_MAX + local.history[current.white_turn][code];
+        }
+    }
+
+    for (size_t i = 1; i < moves.size(); ++i)
+    {
+        const std::pair<move_code, state> move = moves[i];
+        const int score = scores[i];
+
+        size_t j = i;
+        for (; j > 0 && scores[j - 1] < score; --j)
+        {
+            moves[j] = moves[j - 1];
+            scores[j] = scores[j - 1];
+        }
+
+        moves[j] = move;
+        scores[j] = score;
+    }
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::record_cutoff (bool white, move_code code, int depth, size_t ply)
+{
+    move_history &local = local_history();
+
+    if (ply < MAX_DEPTH && local.killers[ply][0] != code)
+    {
+        local.killers[ply][1] = local.killers[ply][0];
+        local.killers[ply][0] = code;
+    }
+
+    unsigned *history = local.history[white];
+    history[code] += depth * depth;
+    if (history[code] >= HISTORY_MAX)
+        for (int i = 0; i < state::max_move_codes(); ++i)
+            history[i] /= 2;
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::search(state current,
+                       search_path &path,
+                       int depth,
+                       double alpha,
+                       double beta,
+                       bool maximizing)
+{
+    // the root searches all of its moves
+    const bool root = path.empty();
+
+    if (root)
+        maximizing = current.white_turn;
+
+    // invalid state, or a search nobody waits for any more
+    if (!current.is_valid() || stopped.load() || path.cancelled())
+        return;
+
+    // mirrored states share one entry, and the moves of a node are numbered as in its canonical state
+    current = canonical(current);
+    const int hashed = current.pack();
+
+    thread_stats &local = local_stats();
+
+    evaluating_node_data node;
+    const bool known = table.find(hashed, node);
+
+    thread_stats::add(local.table_probes);
+    thread_stats::add(local.table_hits, known);
+
+    // the state has been evaluated deep enough before, and its score is either
+    // exact or a bound that falls outside the window anyway; reproducible scores
+    // are only taken from the same depth, and never from a path of their own
+    if (!root && known && node.evaluated_depth >= depth &&
+        (!limits.reproducible || (!node.cyclic && (node.evaluated_depth == depth || node.evaluated_depth > MAX_DEPTH))) &&
+        ((node.score - node.alpha > EPSILON && node.beta - node.score > EPSILON) ||
+         (node.score - node.beta >= -EPSILON && node.score - beta >= -EPSILON) ||
+         (node.score - node.alpha <= EPSILON && node.score - alpha <= EPSILON)))
+    {
+        thread_stats::add(local.table_cutoffs);
+        return;
+    }
+
+    thread_stats::add(local.nodes);
+
+    // the shared counter is only needed, and only contended, under a budget of states
+    const size_t evaluated = limits.states ? state_evaluated.fetch_add(1, std::memory_order_relaxed) + 1 :
+                                             local.nodes.load(std::memory_order_relaxed);
+    if (out_of_budget(evaluated))
+    {
+        stopped.store(true);
+        return;
+    }
+
+    // the game is over
+    if (current.is_over())
+    {
+        node.score = ABS_SCORE * (current.get_winner() == 'W' ? 1 : -1);
+        node.evaluated_depth = MAX_DEPTH + 1; // ending states need no further evaluation
+        node.alpha = -SCORE_RANGE;
+        node.beta = SCORE_RANGE;
+        node.cyclic = false;
+        table.set(hashed, node);
+        return;
+    }
+
+    // depth reaches 0
+    if (!depth)
+    {
+        calculate_original_score(current, node);
+        node.evaluated_depth = depth;
+        node.alpha = -SCORE_RANGE; // the score is exact, whatever window it was asked with
+        node.beta = SCORE_RANGE;
+        node.cyclic = false;
+        table.set(hashed, node);
+        return;
+    }
+
+    // moves searched by earlier evaluations are searched again, and reproducible scores search all of them
+    const uint64_t searched = known && node.generation == generation && !limits.reproducible ? node.evaluated_moves : 0;
+
+    // the entry is written once all the moves are in, so that other tasks never probe a half-searched node
+    search_node result(alpha, beta, SCORE_RANGE * (maximizing ? -1 : 1));
+
+    // mark as on the path
+    const size_t ply = path.size();
+    path.push(hashed);
+
+    // evaluate all the moves
+    std::vector<std::pair<move_code, state> > moves;
+
+    for (const typename GameGraph::edge &e : graph.successors(hashed))
+    {
+        const state next = canonical(state::unpack(e.hash));
+
+        // the state is already being evaluated further up this path
+        if (path.contains(next.pack()))
+        {
+            result.cycle_ply = std::min(result.cycle_ply, path.ply_of(next.pack()));
+            thread_stats::add(local.cycles);
+            continue;
+        }
+
+        // moves into mirrored states are the same move
+        if (std::none_of(moves.begin(), moves.end(), [&](const std::pair<move_code, state> &move) {
+                return move.second.pack() == next.pack();
+            }))
+            moves.push_back(std::make_pair(e.code, next));
+    }
+
+    order_moves(current, moves, known && node.evaluated_depth > 0 ? node.best_move.get_code() : -1, ply);
+
+    const int hands = current.count_hands();
+
+    // returns false once the remaining moves are not needed
+    auto evaluate = [&](size_t i, search_path &path) -> bool {
+        const state &next = moves[i].second;
+        const double lower = result.alpha.load(), upper = result.beta.load();
+
+        // a move searched earlier in this iteration keeps its result
+        if (!(searched >> moves[i].first & 1) || table.get(next.pack()).evaluated_depth < depth - 1)
+        {
+            if (!limits.pvs || !i || upper - lower <= NULL_WINDOW)
+                search(next, path, depth - 1, lower, upper, !maximizing);
+            else
+            {
+                // late moves that leave every hand as it was are the likeliest to be no better
+                const int reduction = limits.lmr && i >= LMR_MOVES && depth >= LMR_DEPTH && next.count_hands() == hands;
+
+                if (maximizing)
+                    search(next, path, depth - 1 - reduction, lower, lower + NULL_WINDOW, !maximizing);
+                else
+                    search(next, path, depth - 1 - reduction, upper - NULL_WINDOW, upper, !maximizing);
+
+                // a move that is better is searched again with the full window, even if it cuts off:
+                // the null window only bounds its score, which the node would otherwise keep
+                const bool aborted = stopped.load() || path.cancelled();
+                const double score = aborted ? 0 : table.get(next.pack()).score;
+                const bool better = maximizing ? score - lower > EPSILON : score - upper < -EPSILON;
+                if (!aborted && better)
+                    search(next, path, depth - 1, result.alpha.load(), result.beta.load(), !maximizing);
+            }
+        }
+
+        // a stopped or cancelled search leaves its nodes unwritten, so there is nothing to fold in
+        if (stopped.load() || path.cancelled())
+            return false;
+
+        after_search(moves[i], result, maximizing);
+
+        if (root || !result.is_cut())
+            return true;
+
+        thread_stats::add(local_stats().cutoffs_by_move[i]);
+        record_cutoff(current.white_turn, moves[i].first, depth, ply);
+        return false;
+    };
+
+    if (depth >= SPLIT_DEPTH && moves.size() > 1 && Pool.num_of_threads() > 1)
+    {
+        // young brothers wait: the eldest move goes first, so that the others start with its bound
+        if (evaluate(0, path))
+        {
+            Thread::TaskGroup brothers(Pool);
+
+            // each brother gets its own copy of the path, and gives up on it once another one cuts off
+            brothers.add_range(1, moves.size(), [&](size_t i) {
+                search_path task_path = path;
+                task_path.split(brothers);
+                if (!evaluate(i, task_path))
+                    brothers.cancel();
+            });
+            brothers.wait();
+        }
+    }
+    else
+        for (size_t i = 0; i < moves.size(); ++i)
+            if (!evaluate(i, path))
+                break;
+
+    // mark as off the path
+    path.pop();
+
+    // the node keeps what it had before this iteration
+    if (stopped.load() || path.cancelled())
+        return;
+
+    table.update(hashed, [&](evaluating_node_data &node) {
+        node.score = result.score;
+        node.alpha = alpha;
+        node.beta = beta;
+        node.cyclic = result.cycle_ply < ply;
+        node.cycle_ply = result.cycle_ply;
+
+        if (limits.reproducible)
+            node.evaluated_depth = depth;
+
+        if (result.improved)
+        {
+            node.evaluated_depth = depth;
+            node.best_move = move_data::from_code(result.best_move);
+        }
+
+        if (node.generation != generation)
+        {
+            node.generation = generation;
+            node.evaluated_moves = 0;
+        }
+        node.evaluated_moves |= result.evaluated_moves;
+    });
+}
+
+template< typename Rules >
+node_data BasicEvaluator<Rules>::get_node_data(int hash_state) const
+{
+    node_data ret;
+
+    // solved states are answered without searching, from the book if it has them
+    if (is_solved(hash_state))
+    {
+        const solved_node_data node = book.has_state(hash_state) ? book.get_node_data(hash_state) : solver.get_node_data(hash_state);
+
+        ret.score = node.winner == 'D' ? 0 : ABS_SCORE * (node.winner == 'W' ? 1 : -1);
+        ret.evaluated_depth = MAX_DEPTH + 1;
+        ret.best_move = node.best_move;
+        ret.proven = true;
+        ret.distance = node.distance;
+
+        return ret;
+    }
+
+    // the table has the canonical state, whose best move is mirrored back
+    typename state::symmetry sym = 0;
+    const state current = state::parse_hash(hash_state);
+    const state representative = canonical(current, &sym);
+
+    evaluating_node_data node;
+    if (!table.find(representative.pack(), node))
+        throw std::runtime_error("Unknown game state: The state is either invalid or not evaluated");
+
+    ret.score = node.score;
+    ret.evaluated_depth = node.evaluated_depth;
+    ret.best_move = move_data::from_code(state::transform_move(node.best_move.get_code(), sym, current.white_turn));
+
+    return ret;
+}
+
+template< typename Rules >
+node_data BasicEvaluator<Rules>::get_node_data(state game_state) const
+{
+    return get_node_data(game_state.get_hash());
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::evaluate_next_move(int hash_state, const search_limits &_limits)
+{
+    return evaluate_next_move(state::parse_hash(hash_state), _limits);
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::evaluate_next_move(state game_state, const search_limits &_limits)
+{
+    if (!game_state.is_valid() || game_state.is_over())
+        throw std::runtime_error("Next move evaluation does not exist for invalid or ended games");
+
+    stop_pondering();
+
+    ++generation;
+    stopped.store(false);
+    state_evaluated.store(0);
+
+    for (size_t i = 0; i <= Pool.num_of_threads(); ++i)
+    {
+        stats[i].clear();
+        histories[i].age();
+    }
+    {
+        THREAD_LOCK(lock, depth_mutex, "Evaluator::depth_seconds");
+        depth_seconds.clear();
+        started = std::chrono::steady_clock::now();
+        idle_at_start = Pool.idle_seconds(); // counts the sleeps going on up to now, so they only count from here
+    }
+
+    // the answer is already known
+    if (is_solved(game_state.get_hash()))
+        return;
+
+    deepen(game_state, _limits, true);
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::deepen(state game_state, const search_limits &_limits, bool timed)
+{
+    limits = _limits;
+    limits.depth = std::max(1, std::min(limits.depth, MAX_DEPTH));
+    deadline = std::chrono::steady_clock::now() +
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(limits.seconds));
+    limited = false;
+
+    game_state = canonical(game_state);
+    const int hashed = game_state.pack();
+    evaluating_node_data completed; // the root after the last completed iteration
+
+    for (int depth = 1; depth <= limits.depth; ++depth)
+    {
+        const auto iteration_started = std::chrono::steady_clock::now();
+
+        // aspiration window around the previous score
+        double alpha = -ABS_SCORE, beta = ABS_SCORE;
+        if (limited)
+        {
+            alpha = std::max(-ABS_SCORE, completed.score - ASPIRATION_WINDOW);
+            beta = std::min(ABS_SCORE, completed.score + ASPIRATION_WINDOW);
+        }
+
+        while (true)
+        {
+            ++generation;
+
+            search_path path(state::hash_count());
+            search(game_state, path, depth, alpha, beta);
+
+            if (stopped.load())
+                break;
+
+            // the score fell out of the window, so it is only a bound: search again with the full window
+            const double score = table.get(hashed).score;
+            if ((alpha > -ABS_SCORE && score - alpha <= EPSILON) || (beta < ABS_SCORE && beta - score <= EPSILON))
+            {
+                alpha = -ABS_SCORE;
+                beta = ABS_SCORE;
+                continue;
+            }
+
+            break;
+        }
+
+        // an aborted re-search may have left the root with a bound, so put the completed iteration back
+        if (stopped.load())
+        {
+            if (limited)
+                table.set(hashed, completed);
+            break;
+        }
+
+        completed = table.get(hashed);
+        limited = true;
+
+        if (timed)
+        {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - iteration_started;
+
+            THREAD_LOCK(lock, depth_mutex, "Evaluator::depth_seconds");
+            depth_seconds.push_back(elapsed.count());
+        }
+    }
+}
+
+template< typename Rules >
+size_t BasicEvaluator<Rules>::get_last_number_of_evaluated_states() const
+{
+    size_t ret = 0;
+    for (size_t i = 0; i <= Pool.num_of_threads(); ++i)
+        ret += stats[i].nodes.load(std::memory_order_relaxed);
+
+    return ret;
+}
+
+template< typename Rules >
+search_stats BasicEvaluator<Rules>::get_search_stats() const
+{
+    search_stats ret;
+    ret.cutoffs_by_move.assign(state::max_moves(), 0);
+
+    for (size_t i = 0; i <= Pool.num_of_threads(); ++i)
+    {
+        const thread_stats &local = stats[i];
+
+        ret.nodes += local.nodes.load(std::memory_order_relaxed);
+        ret.table_probes += local.table_probes.load(std::memory_order_relaxed);
+        ret.table_hits += local.table_hits.load(std::memory_order_relaxed);
+        ret.table_cutoffs += local.table_cutoffs.load(std::memory_order_relaxed);
+        ret.cycles += local.cycles.load(std::memory_order_relaxed);
+
+        for (int move = 0; move < state::max_moves(); ++move)
+            ret.cutoffs_by_move[move] += local.cutoffs_by_move[move].load(std::memory_order_relaxed);
+    }
+
+    // the moves past the last one that ever cut off are of no interest
+    while (!ret.cutoffs_by_move.empty() && !ret.cutoffs_by_move.back())
+        ret.cutoffs_by_move.pop_back();
+
+    {
+        THREAD_LOCK(lock, depth_mutex, "Evaluator::depth_seconds");
+        ret.depth_seconds = depth_seconds;
+        ret.idle_seconds = Pool.idle_seconds() - idle_at_start;
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        ret.seconds = elapsed.count();
+    }
+
+    ret.waiting_tasks = Pool.num_of_waiting_tasks();
+
+    return ret;
+}
+
+template< typename Rules >
+size_t BasicEvaluator<Rules>::get_number_of_stored_states() const
+{
+    return table.size();
+}
+
+template< typename Rules >
+bool BasicEvaluator<Rules>::load_book (const std::string &path)
+{
+    stop_pondering();
+    return book.open(path);
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::stop()
+{
+    stopped.store(true);
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::ponder(state game_state)
+{
+    if (!game_state.is_valid() || game_state.is_over())
+        throw std::runtime_error("Pondering does not exist for invalid or ended games");
+
+    stop_pondering();
+    stopped.store(false);
+
+    game_state = canonical(game_state);
+    const int hashed = game_state.pack();
+
+    // the likeliest reply is the one we would play in the opponent's place;
+    // mirrored replies are searched once
+    std::vector<state> replies;
+    for (const typename GameGraph::edge &e : graph.successors(hashed))
+    {
+        const state reply = canonical(state::unpack(e.hash));
+        if (!reply.is_over() && !is_solved(e.hash) &&
+            std::none_of(replies.begin(), replies.end(), [&](const state &other) { return other.pack() == reply.pack(); }))
+            replies.push_back(reply);
+    }
+
+    evaluating_node_data node;
+    state likeliest = game_state;
+    if (table.find(hashed, node) && likeliest.try_make_move(node.best_move) == MOVE_LEGAL)
+    {
+        const auto it = std::find_if(replies.begin(), replies.end(), [&](const state &reply) {
+            return reply.pack() == canonical(likeliest).pack();
+        });
+        if (it != replies.end())
+            std::rotate(replies.begin(), it, it + 1);
+    }
+
+    pondering.spawn([this, replies]() {
+        for (const state &reply : replies)
+        {
+            if (stopped.load())
+                break;
+
+            deepen(reply, search_limits());
+        }
+    });
+}
+
+template< typename Rules >
+void BasicEvaluator<Rules>::stop_pondering()
+{
+    stop();
+    pondering.wait();
+}
+
+#endif // EVALUATOR_INL
@@ -0,0 +1,3 @@
+#include "Evaluator.inl"
+
+template class BasicEvaluator<limited_split_rules>;
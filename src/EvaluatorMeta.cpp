@@ -0,0 +1,3 @@
+#include "Evaluator.inl"
+
+template class BasicEvaluator<meta_rules>;
@@ -0,0 +1,3 @@
+#include "Evaluator.inl"
+
+template class BasicEvaluator<strict_split_rules>;
@@ -0,0 +1,103 @@
+#include "GameGraph.h"
+#include <stdexcept>
+
+template< typename Rules >
+void BasicGameGraph<Rules>::generate_edges (const state &current, std::vector<edge> &edges)
+{
+    move_data moves[state::max_moves()];
+    state targets[state::max_moves()];
+
+    const int count = current.generate_moves(moves, targets);
+    for (int i = 0; i < count; ++i)
+        edges.push_back({ (int)targets[i].pack(), moves[i].get_code() });
+}
+
+template< typename Rules >
+BasicGameGraph<Rules>::BasicGameGraph()
+{
+    const int size = state::hash_count();
+
+    valid.assign(size, false);
+    successor_offsets.assign(size + 1, 0);
+    predecessor_offsets.assign(size + 1, 0);
+
+    // successors, row by row
+    for (int hash = 0; hash < size; ++hash)
+    {
+        const state current = state::unpack(hash);
+
+        if (current.is_valid())
+        {
+            valid[hash] = true;
+
+            if (!current.is_over())
+                generate_edges(current, successor_edges);
+        }
+
+        successor_offsets[hash + 1] = successor_edges.size();
+    }
+
+    // predecessors, by counting the edges into every state first
+    for (const edge &e : successor_edges)
+        ++predecessor_offsets[e.hash + 1];
+    for (int hash = 0; hash < size; ++hash)
+        predecessor_offsets[hash + 1] += predecessor_offsets[hash];
+
+    std::vector<int> filled(predecessor_offsets.begin(), predecessor_offsets.end() - 1);
+    predecessor_edges.resize(successor_edges.size());
+
+    for (int hash = 0; hash < size; ++hash)
+        for (int i = successor_offsets[hash]; i < successor_offsets[hash + 1]; ++i)
+            predecessor_edges[filled[successor_edges[i].hash]++] = { hash, successor_edges[i].code };
+}
+
+template< typename Rules >
+int BasicGameGraph<Rules>::size() const
+{
+    return valid.size();
+}
+
+template< typename Rules >
+bool BasicGameGraph<Rules>::has_state (int hash_state) const
+{
+    return hash_state >= 0 && hash_state < size() && valid[hash_state];
+}
+
+template< typename Rules >
+size_t BasicGameGraph<Rules>::number_of_states() const
+{
+    size_t ret = 0;
+    for (bool v : valid)
+        ret += v;
+    return ret;
+}
+
+template< typename Rules >
+size_t BasicGameGraph<Rules>::number_of_edges() const
+{
+    return successor_edges.size();
+}
+
+template< typename Rules >
+typename BasicGameGraph<Rules>::edge_range BasicGameGraph<Rules>::successors (int hash_state) const
+{
+    if (!has_state(hash_state))
+        throw std::runtime_error("Unknown game state: The state is not part of the game graph");
+
+    const edge *edges = successor_edges.data();
+    return edge_range(edges + successor_offsets[hash_state], edges + successor_offsets[hash_state + 1]);
+}
+
+template< typename Rules >
+typename BasicGameGraph<Rules>::edge_range BasicGameGraph<Rules>::predecessors (int hash_state) const
+{
+    if (!has_state(hash_state))
+        throw std::runtime_error("Unknown game state: The state is not part of the game graph");
+
+    const edge *edges = predecessor_edges.data();
+    return edge_range(edges + predecessor_offsets[hash_state], edges + predecessor_offsets[hash_state + 1]);
+}
+
+// every variant in Rules.hpp
+#define INSTANTIATE(Rules) template class BasicGameGraph<Rules>;
+CHOPSTICKS_RULES(INSTANTIATE)
@@ -0,0 +1,280 @@
+#include "GenericRules.h"
+#include <algorithm>
+#include <climits>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+
+namespace Generic
+{
+    static std::string trim (const std::string &text)
+    {
+        const size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    static short parse_short (const std::string &name, const std::string &value)
+    {
+        size_t length = 0;
+        int ret = 0;
+
+        try
+        {
+            ret = std::stoi(value, &length);
+        }
+        catch (const std::exception&)
+        {
+            length = 0;
+        }
+
+        if (!length || length != value.length() || ret < SHRT_MIN || ret > SHRT_MAX)
+            throw std::runtime_error("Parse error: " + name + " should be a number, not " + value);
+
+        return ret;
+    }
+
+    static bool parse_bool (const std::string &name, const std::string &value)
+    {
+        if (value == "true" || value == "yes" || value == "1")
+            return true;
+        if (value == "false" || value == "no" || value == "0")
+            return false;
+
+        throw std::runtime_error("Parse error: " + name + " should be true or false, not " + value);
+    }
+
+    rule_parameters::rule_parameters()
+    {
+        for (int player = 0; player < MAX_PLAYERS; ++player)
+        {
+            for (int hand = 0; hand < MAX_HANDS; ++hand)
+                hand_max[player][hand] = 5;
+            split_max[player] = -1;
+        }
+    }
+
+    rule_parameters rule_parameters::parse (std::istream &in)
+    {
+        rule_parameters ret;
+        std::string line;
+
+        while (std::getline(in, line))
+        {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty())
+                continue;
+
+            const size_t equals = line.find('=');
+            if (equals == std::string::npos)
+                throw std::runtime_error("Parse error: Rules should be given as name = value, not " + line);
+
+            const std::string name = trim(line.substr(0, equals)), value = trim(line.substr(equals + 1));
+
+            if (name == "players")
+                ret.players = parse_short(name, value);
+            else if (name == "hands")
+                ret.hands = parse_short(name, value);
+            else if (name == "hand_max")
+            {
+                const short max = parse_short(name, value);
+                for (int player = 0; player < MAX_PLAYERS; ++player)
+                    for (int hand = 0; hand < MAX_HANDS; ++hand)
+                        ret.hand_max[player][hand] = max;
+            }
+            else if (name == "split_max")
+            {
+                const short max = parse_short(name, value);
+                for (int player = 0; player < MAX_PLAYERS; ++player)
+                    ret.split_max[player] = max;
+            }
+            else if (name == "white_left_hand_max")
+                ret.hand_max[0][0] = parse_short(name, value);
+            else if (name == "white_right_hand_max")
+                ret.hand_max[0][1] = parse_short(name, value);
+            else if (name == "black_left_hand_max")
+                ret.hand_max[1][0] = parse_short(name, value);
+            else if (name == "black_right_hand_max")
+                ret.hand_max[1][1] = parse_short(name, value);
+            else if (name == "white_split_max")
+                ret.split_max[0] = parse_short(name, value);
+            else if (name == "black_split_max")
+                ret.split_max[1] = parse_short(name, value);
+            else if (name == "splits_as_moves")
+                ret.splits_as_moves = parse_bool(name, value);
+            else if (name == "allow_sacrifical_splits")
+                ret.allow_sacrifical_splits = parse_bool(name, value);
+            else if (name == "allow_regenerative_splits")
+                ret.allow_regenerative_splits = parse_bool(name, value);
+            else if (name == "meta_variant")
+                ret.meta_variant = parse_bool(name, value);
+            else
+                throw std::runtime_error("Parse error: Unknown rule " + name);
+        }
+
+        return ret;
+    }
+
+    rule_parameters rule_parameters::parse (const std::string &text)
+    {
+        std::istringstream in(text);
+        return parse(in);
+    }
+
+    Rules::Rules (const rule_parameters &_parameters): parameters(_parameters)
+    {
+        if (players() < 2 || players() > rule_parameters::MAX_PLAYERS)
+            throw std::runtime_error("Invalid rules: There should be 2 to " + std::to_string(rule_parameters::MAX_PLAYERS) + " players");
+        if (hands() < 1 || hands() > rule_parameters::MAX_HANDS)
+            throw std::runtime_error("Invalid rules: Players should have 1 to " + std::to_string(rule_parameters::MAX_HANDS) + " hands");
+
+        for (int player = 0; player < players(); ++player)
+        {
+            for (int hand = 0; hand < hands(); ++hand)
+                if (hand_max(player, hand) < 2 || hand_max(player, hand) > MAX_HAND)
+                    throw std::runtime_error("Invalid rules: Hand maxima should be between 2 and " + std::to_string(MAX_HAND));
+
+            // a counter of zero would leave the player without splits for good
+            if (!split_max(player))
+                throw std::runtime_error("Invalid rules: Split maxima should be positive, or negative for unlimited splits");
+        }
+
+        build_strides();
+        build_sums();
+        build_splits();
+    }
+
+    // multiplies the radices up from the last field, checked all the way,
+    // since the product overflows quickly with more or larger hands
+    static packed_state next_stride (packed_state &stride, packed_state radix)
+    {
+        const packed_state ret = stride;
+
+        if (stride > UINT64_MAX / radix)
+            throw std::runtime_error("Invalid rules: The variant has too many states to hash in 64 bits");
+        stride *= radix;
+
+        return ret;
+    }
+
+    void Rules::build_strides()
+    {
+        packed_state stride = 1;
+
+        for (int player = players() - 1; player >= 0; --player)
+            split_strides[player] = next_stride(stride, split_max(player) > 0 ? split_max(player) + 1 : 1);
+
+        for (int player = players() - 1; player >= 0; --player)
+            for (int hand = hands() - 1; hand >= 0; --hand)
+                hand_strides[player][hand] = next_stride(stride, hand_max(player, hand));
+
+        turn_stride = next_stride(stride, players());
+        count = stride;
+    }
+
+    void Rules::build_sums()
+    {
+        for (int player = 0; player < players(); ++player)
+            for (int hand = 0; hand < hands(); ++hand)
+            {
+                std::vector<unsigned char> &sum = sums[player][hand];
+                sum.assign(hand_max(player, hand) * MAX_HAND, 0);
+
+                for (int value = 0; value < hand_max(player, hand); ++value)
+                    for (int fingers = 0; fingers < MAX_HAND; ++fingers)
+                        sum[value * MAX_HAND + fingers] = (value + fingers) % hand_max(player, hand);
+            }
+    }
+
+    void Rules::build_splits()
+    {
+        pairs.clear();
+        for (int a = 0; a < hands(); ++a)
+            for (int b = a + 1; b < hands(); ++b)
+                pairs.push_back(std::make_pair(a, b));
+
+        splits.clear();
+        int most_splits = 0;
+
+        for (int player = 0; player < players(); ++player)
+        {
+            std::vector<int> &offsets = split_offsets[player];
+            offsets.assign(1, splits.size());
+            pair_offsets[player].clear();
+
+            int player_splits = 0;
+
+            for (const std::pair<int, int> &pair : pairs)
+            {
+                const int max_a = hand_max(player, pair.first), max_b = hand_max(player, pair.second);
+                pair_offsets[player].push_back(offsets.size() - 1);
+                player_splits += max_a + max_b - 2;
+
+                // row by row, in the order the specialized move generator tries the splits of the left and right hand
+                for (int a = 0; a < max_a; ++a)
+                    for (int b = 0; b < max_b; ++b)
+                    {
+                        for (int change = -a; change <= b; ++change)
+                        {
+                            split s;
+                            short new_a, new_b;
+
+                            if (check_split(player, pair.first, pair.second, a, b, change, -change, new_a, new_b) != MOVE_LEGAL)
+                                continue;
+
+                            s.a = new_a;
+                            s.b = new_b;
+                            s.change = change;
+                            splits.push_back(s);
+                        }
+
+                        offsets.push_back(splits.size());
+                    }
+            }
+
+            most_splits = std::max(most_splits, player_splits);
+        }
+
+        moves = hands() * (players() - 1) * hands() + most_splits;
+    }
+
+    move_status Rules::check_split (int player, int a, int b, int value_a, int value_b, int change_a, int change_b,
+                                    short &new_a, short &new_b) const
+    {
+        if (1LL * change_a * change_b >= 0)
+            return MOVE_BAD_SPLIT;
+
+        const bool a_decrease = change_a < 0;
+        change_a = abs(change_a);
+        change_b = abs(change_b);
+
+        const short max_a = hand_max(player, a), max_b = hand_max(player, b);
+        const bool sacrificial = parameters.allow_sacrifical_splits;
+
+        if (!parameters.allow_regenerative_splits && !(value_a && value_b))
+            return MOVE_REGENERATIVE_SPLIT;
+
+        if ((a_decrease && value_a < change_a + !sacrificial) || // decrease leads to zero hand a
+           (!a_decrease && value_b < change_b + !sacrificial) || // decrease leads to zero hand b
+           (!a_decrease && !sacrificial && (value_a + change_a) % max_a == 0) || // increase leads to zero hand a
+            (a_decrease && !sacrificial && (value_b + change_b) % max_b == 0)) // increase leads to zero hand b
+            return MOVE_SACRIFICIAL_SPLIT;
+
+        const int changed_a = value_a + change_a * (a_decrease ? -1 : 1),
+                  changed_b = value_b + change_b * (!a_decrease ? -1 : 1);
+
+        // check if the moves are hand-alternating
+        if (value_a == changed_b && value_b == changed_a)
+            return MOVE_HAND_SWITCHING_SPLIT;
+
+        if (!parameters.meta_variant && changed_a % max_a + changed_b % max_b != value_a + value_b)
+            return MOVE_SUBTRACTING_SPLIT;
+
+        new_a = changed_a % max_a;
+        new_b = changed_b % max_b;
+
+        return MOVE_LEGAL;
+    }
+}
@@ -0,0 +1,118 @@
+#include "Solver.h"
+#include <queue>
+#include <stdexcept>
+
+template< typename Rules >
+void BasicSolver<Rules>::solve (const GameGraph &graph)
+{
+    const int size = graph.size();
+
+    table.assign(size, solved_node_data());
+    valid.assign(size, false);
+
+    std::vector<size_t> remaining(size, 0);
+    std::vector<bool> labeled(size, false);
+    std::queue<int> queue;
+
+    for (int hash = 0; hash < size; ++hash)
+    {
+        if (!graph.has_state(hash))
+            continue;
+
+        valid[hash] = true;
+
+        const state current = state::unpack(hash);
+
+        // ending states seed the analysis
+        if (current.is_over())
+        {
+            table[hash].winner = current.get_winner();
+            table[hash].distance = 0;
+            labeled[hash] = true;
+            queue.push(hash);
+        }
+        else
+            remaining[hash] = graph.successors(hash).size();
+    }
+
+    // states are dequeued in increasing distance, so wins get the shortest
+    // and losses the longest way to the end
+    while (!queue.empty())
+    {
+        const int hash = queue.front();
+        queue.pop();
+
+        const solved_node_data &node = table[hash];
+
+        for (const typename GameGraph::edge &e : graph.predecessors(hash))
+        {
+            const int parent = e.hash;
+            if (labeled[parent])
+                continue;
+
+            const char mover = state::unpack(parent).white_turn ? 'W' : 'B';
+
+            // the mover either has a move into a won state, or all of its moves lose
+            if (node.winner == mover || !--remaining[parent])
+            {
+                table[parent].winner = node.winner;
+                table[parent].distance = node.distance + 1;
+                table[parent].best_move = move_data::from_code(e.code);
+                labeled[parent] = true;
+                queue.push(parent);
+            }
+        }
+    }
+
+    // whatever is left cannot be forced to an end by either side, so keep the game going
+    for (int hash = 0; hash < size; ++hash)
+        if (valid[hash] && !labeled[hash])
+            for (const typename GameGraph::edge &e : graph.successors(hash))
+                if (!labeled[e.hash])
+                {
+                    table[hash].best_move = move_data::from_code(e.code);
+                    break;
+                }
+
+    solved = true;
+}
+
+template< typename Rules >
+bool BasicSolver<Rules>::is_solved() const
+{
+    return solved;
+}
+
+template< typename Rules >
+bool BasicSolver<Rules>::has_state (int hash_state) const
+{
+    return solved && hash_state >= 0 && hash_state < (int)valid.size() && valid[hash_state];
+}
+
+template< typename Rules >
+size_t BasicSolver<Rules>::number_of_states() const
+{
+    size_t ret = 0;
+    for (bool v : valid)
+        ret += v;
+    return ret;
+}
+
+template< typename Rules >
+solved_node_data BasicSolver<Rules>::get_node_data (int hash_state) const
+{
+    if (!has_state(hash_state))
+        throw std::runtime_error("Unknown game state: The state is either invalid or not solved");
+
+    return table[hash_state];
+}
+
+template< typename Rules >
+solved_node_data BasicSolver<Rules>::get_node_data (const state &game_state) const
+{
+    return get_node_data(game_state.get_hash());
+}
+
+// every variant in Rules.hpp
+#define INSTANTIATE(Rules) template class BasicSolver<Rules>;
+CHOPSTICKS_RULES(INSTANTIATE)
@@ -7,6 +7,8 @@
 #include <thread>
 #include <windows.h>
 
+#define BOOK_FILE "chopsticks.book"
+
 #define KEY_BACKSPACE 8
 #define KEY_UP 72
 #define KEY_DOWN 80
@@ -107,8 +109,13 @@ void UI::game(Evaluator *evaluator, bool white_turn, bool two_computers)
             evaluator->evaluate_next_move(game_state);
             node_data node = evaluator->get_node_data(game_state);
             to_row_col(21, 0);
-            std::cout << "--  Evaluation (states: " << evaluator->get_last_number_of_evaluated_states()
-                      << ", depth " << node.evaluated_depth << "):  " << node.score;
+            if (node.proven)
+                std::cout << "--  Evaluation (solved, " << (node.distance < 0 ? std::string("draw") :
+                                                            "ends in " + std::to_string(node.distance) + " plies")
+                          << "):  " << node.score;
+            else
+                std::cout << "--  Evaluation (states: " << evaluator->get_last_number_of_evaluated_states()
+                          << ", depth " << node.evaluated_depth << "):  " << node.score;
         }
         else
         {
@@ -120,7 +127,12 @@ void UI::game(Evaluator *evaluator, bool white_turn, bool two_computers)
         if (!game_state.is_over())
         {
             if (!two_computers && game_state.white_turn == white_turn)
+            {
                 std::cout << "    Your move:  ";
+
+                // think about the replies while the user does
+                evaluator->ponder(game_state);
+            }
             else
             {
                 std::cout << "    Computer " << (two_computers ? (std::to_string(1 + which_computer) + " ") : "") << "is playing... ";
@@ -175,7 +187,10 @@ first_input:
                 while (toupper(ch) != 'Y' && toupper(ch) != 'N')
                     ch = getch();
                 if (toupper(ch) == 'Y')
+                {
+                    evaluator->stop_pondering();
                     return;
+                }
                 else
                     goto first_input;
             }
@@ -293,6 +308,7 @@ finalize:
             try
             {
                 game_handler.make_move(move);
+                evaluator->stop_pondering();
                 break;
             }
             catch (const std::runtime_error &e)
@@ -308,8 +324,25 @@ void UI::run()
 {
     std::cout << std::fixed << std::setprecision(15);
 
+    std::cout << "Starting the engine... ";
+
     Evaluator *evaluator = new Evaluator();
 
+    std::cout << "Done" << std::endl
+              << "Press any key to continue... ";
+    getch();
+
+    try
+    {
+        evaluator->load_book(BOOK_FILE);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cout << e.what() << std::endl
+                  << "Press any key to continue without it... ";
+        getch();
+    }
+
     char user = '\0';
 
     while (user != 'Q')
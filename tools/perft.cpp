@@ -0,0 +1,319 @@
+#include "GenericRules.h"
+#include "GenericState.hpp"
+#include "Perft.hpp"
+#include "Rules.hpp"
+#include "State.hpp"
+#include "Thread.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// Counts the leaves of the game tree from a position, depth by depth, with
+// one thread or with the pool. --divide breaks the count down by the moves
+// of the position. --validate counts the tree with every move generator there
+// is, the rule checks of the state, its generate_moves and the tables of the
+// generic state, and walks down to the first position they disagree on.
+
+class options
+{
+public:
+    std::string rules = "standard_rules";
+    int depth = 0;
+    size_t num_of_threads = 0; // 0 for one thread without the pool
+    bool divide = false;
+    bool validate = false;
+    std::string position;
+};
+
+// a legal move, the leaves below it and the hash of the state it leads to
+struct branch
+{
+    move_code code;
+    int child;
+    uint64_t leaves;
+};
+
+typedef std::function<std::vector<branch>(int hash, int depth)> counter;
+
+template< typename Rules >
+counter basic_counter (bool reference)
+{
+    typedef basic_state<Rules> state;
+
+    return [reference](int hash, int depth) {
+        const state position = state::unpack(hash);
+        std::vector<branch> ret;
+
+        for (const auto &d : BasicPerft<Rules>::divide(position, depth, reference))
+        {
+            state child = position;
+            child.try_make_move(d.first);
+            ret.push_back({ d.first.get_code(), (int)child.pack(), d.second });
+        }
+
+        return ret;
+    };
+}
+
+// the tables of the generic state, which hashes two-player variants like basic_state
+class generic_perft
+{
+private:
+    Generic::Rules rules;
+    std::vector<std::vector<Generic::move> > moves;
+    std::vector<std::vector<Generic::state> > targets;
+
+public:
+    explicit generic_perft (const Generic::rule_parameters &parameters): rules(parameters) {}
+
+    uint64_t perft (const Generic::state &position, int depth, int ply = 0)
+    {
+        if (depth <= 0)
+            return 1;
+
+        if ((int)moves.size() <= ply)
+        {
+            moves.resize(ply + 1, std::vector<Generic::move>(rules.max_moves()));
+            targets.resize(ply + 1, std::vector<Generic::state>(rules.max_moves(), Generic::state(rules)));
+        }
+
+        const int count = position.generate_moves(moves[ply].data(), targets[ply].data());
+        if (depth == 1)
+            return count;
+
+        uint64_t ret = 0;
+        for (int i = 0; i < count; ++i)
+            ret += perft(targets[ply][i], depth - 1, ply + 1);
+
+        return ret;
+    }
+
+    std::vector<branch> divide (int hash, int depth)
+    {
+        const Generic::state position = Generic::state::unpack(rules, hash);
+        std::vector<Generic::move> root_moves(rules.max_moves());
+        std::vector<Generic::state> root_targets(rules.max_moves(), Generic::state(rules));
+
+        std::vector<branch> ret;
+        const int count = position.generate_moves(root_moves.data(), root_targets.data());
+        for (int i = 0; i < count; ++i)
+            ret.push_back({ root_moves[i].to_move_data().get_code(), (int)root_targets[i].pack(),
+                            perft(root_targets[i], depth - 1, 1) });
+
+        std::sort(ret.begin(), ret.end(), [](const branch &a, const branch &b) { return a.code < b.code; });
+        return ret;
+    }
+};
+
+static uint64_t leaves_of (const std::vector<branch> &branches)
+{
+    uint64_t ret = 0;
+    for (const branch &b : branches)
+        ret += b.leaves;
+    return ret;
+}
+
+// follows the first move whose subtrees differ until the moves themselves do
+static void locate (const counter &expected, const counter &actual, const char *name, int hash, int depth)
+{
+    std::string path;
+
+    while (depth > 0)
+    {
+        const std::vector<branch> a = expected(hash, depth), b = actual(hash, depth);
+
+        bool same_moves = a.size() == b.size();
+        for (size_t i = 0; same_moves && i < a.size(); ++i)
+            same_moves = a[i].code == b[i].code && a[i].child == b[i].child;
+
+        if (!same_moves)
+        {
+            std::cout << "  " << name << " generates other moves after [" << path << "] in state " << hash << ":";
+            for (const branch &x : a)
+                std::cout << " " << move_data::from_code(x.code).get_displayable() << "->" << x.child;
+            std::cout << "  vs";
+            for (const branch &x : b)
+                std::cout << " " << move_data::from_code(x.code).get_displayable() << "->" << x.child;
+            std::cout << std::endl;
+            return;
+        }
+
+        size_t i = 0;
+        while (i < a.size() && a[i].leaves == b[i].leaves)
+            ++i;
+        if (i == a.size())
+            return;
+
+        path += (path.empty() ? "" : " ") + move_data::from_code(a[i].code).get_displayable();
+        hash = a[i].child;
+        --depth;
+    }
+}
+
+template< typename Func >
+static double seconds_of (Func func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+template< typename Rules >
+static basic_state<Rules> parse_position (const std::string &text)
+{
+    typedef basic_state<Rules> state;
+
+    std::istringstream in(text);
+    std::string token;
+    state position;
+
+    if (!text.empty() && text.find_first_not_of("0123456789 ") == std::string::npos && in >> token)
+        return state::parse_hash(std::stoi(token));
+
+    while (in >> token)
+    {
+        const move_data move = move_data::parse_displayable(token);
+        if (move.is_split)
+            position.make_split_move(move.fparam, move.sparam);
+        else
+            position.make_move(move.fparam, move.sparam);
+    }
+
+    return position;
+}
+
+template< typename Rules >
+static int run (const options &opts)
+{
+    typedef basic_state<Rules> state;
+    typedef BasicPerft<Rules> Perft;
+
+    const state position = parse_position<Rules>(opts.position);
+    std::unique_ptr<Thread::ThreadPool> pool(opts.num_of_threads ? new Thread::ThreadPool(opts.num_of_threads) : nullptr);
+
+    if (opts.divide)
+    {
+        uint64_t total = 0;
+        for (const auto &d : Perft::divide(position, opts.depth))
+        {
+            std::cout << d.first.get_displayable() << "  " << d.second << std::endl;
+            total += d.second;
+        }
+        std::cout << "total  " << total << std::endl;
+        return 0;
+    }
+
+    if (!opts.validate)
+    {
+        std::cout << "depth  leaves  seconds  leaves/sec" << std::endl;
+        for (int depth = 1; depth <= opts.depth; ++depth)
+        {
+            uint64_t leaves = 0;
+            const double seconds = seconds_of([&]() {
+                leaves = pool ? Perft::perft(*pool, position, depth) : Perft::perft(position, depth);
+            });
+            std::cout << depth << "  " << leaves << "  " << seconds << "  " << leaves / seconds << std::endl;
+        }
+        return 0;
+    }
+
+    generic_perft generic(Generic::rule_parameters::of<Rules>());
+    const counter reference = basic_counter<Rules>(true), generated = basic_counter<Rules>(false);
+    const counter tables = [&generic](int hash, int depth) { return generic.divide(hash, depth); };
+
+    Thread::ThreadPool validation_pool(opts.num_of_threads);
+    int failed = 0;
+
+    std::cout << "depth  reference  generate_moves  pool  generic" << std::endl;
+    for (int depth = 1; depth <= opts.depth; ++depth)
+    {
+        const uint64_t expected = Perft::perft(position, depth, true);
+        const uint64_t fast = Perft::perft(position, depth);
+        const uint64_t parallel = Perft::perft(validation_pool, position, depth);
+        const uint64_t generic_leaves = leaves_of(tables(position.pack(), depth));
+
+        const bool ok = fast == expected && parallel == expected && generic_leaves == expected;
+        std::cout << depth << "  " << expected << "  " << fast << "  " << parallel << "  " << generic_leaves
+                  << "  " << (ok ? "OK" : "MISMATCH") << std::endl;
+
+        if (fast != expected)
+            locate(reference, generated, "generate_moves", position.pack(), depth);
+        if (generic_leaves != expected)
+            locate(reference, tables, "the generic state", position.pack(), depth);
+
+        failed += !ok;
+    }
+
+    return failed ? 1 : 0;
+}
+
+static void usage()
+{
+    std::cerr << "Usage: perft [options] depth [position]" << std::endl
+              << "  --rules NAME   a variant of Rules.hpp, standard_rules by default" << std::endl
+              << "  --threads N    count with a pool of N threads" << std::endl
+              << "  --divide       leaves below every move of the position" << std::endl
+              << "  --validate     compare every move generator to the rule checks" << std::endl
+              << "A position is a game hash, or the moves played from the start, such as \"LR SR1\"." << std::endl;
+}
+
+int main (int argc, char **argv)
+{
+    options opts;
+    bool has_depth = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "--rules" && i + 1 < argc)
+            opts.rules = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            opts.num_of_threads = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--divide")
+            opts.divide = true;
+        else if (arg == "--validate")
+            opts.validate = true;
+        else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-')
+        {
+            usage();
+            return 2;
+        }
+        else if (!has_depth)
+        {
+            opts.depth = atoi(arg.c_str());
+            has_depth = true;
+        }
+        else
+            opts.position += (opts.position.empty() ? "" : " ") + arg;
+    }
+
+    if (!has_depth || opts.depth < 1)
+    {
+        usage();
+        return 2;
+    }
+
+    try
+    {
+#define RUN(Rules) if (opts.rules == #Rules) return run<Rules>(opts);
+        CHOPSTICKS_RULES(RUN)
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Unknown rules: " << opts.rules << std::endl;
+    return 2;
+}
@@ -0,0 +1,31 @@
+#include "Book.h"
+#include "GameGraph.h"
+#include "Solver.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Solves the game under the rules compiled into state and writes the
+// solution book that the engine maps at startup.
+
+int main (int argc, char **argv)
+{
+    const std::string path = argc > 1 ? argv[1] : "chopsticks.book";
+
+    GameGraph graph;
+    Solver solver;
+    solver.solve(graph);
+
+    try
+    {
+        Book::write(path, solver);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << solver.number_of_states() << " solved states to " << path << std::endl;
+    return 0;
+}